@@ -18,14 +18,78 @@
 */
 static int tmpOffset = 0;
 
+/* With the extended ISA (-mext) the left operands
+   of operators and the tmp variables of common
+   subexpressions are kept in registers tr0 and up
+   instead of mp and gp memory: regUsed has bit r
+   set while r is taken, and regName[r] is the tmp
+   variable in r until the statement is done
+*/
+static unsigned regUsed = 0;
+static char * regName[trLim];
+
+/* register holding the value last assigned */
+static int assignReg = ac;
+
 /* prototype for internal recursive code generator */
 static void cGen (TreeNode * tree);
+static int genValue (TreeNode * tree, int target);
+
+/* Function allocReg takes a free register of the
+ * extended ISA, -1 if there is none or no -mext
+ */
+static int allocReg(void)
+{ int r;
+  if (ExtISA)
+    for (r = tr0; r < trLim; r++)
+      if (! (regUsed & (1u << r)))
+      { regUsed |= 1u << r;
+        return r;
+      }
+  return -1;
+} /* allocReg */
+
+static void freeReg(int r)
+{ regUsed &= ~(1u << r); }
+
+/* Procedure freeTemps releases the registers of
+ * the tmp variables at the end of a statement
+ */
+static void freeTemps(void)
+{ int r;
+  for (r = tr0; r < trLim; r++)
+    if (regName[r] != NULL)
+    { regName[r] = NULL;
+      freeReg(r);
+    }
+} /* freeTemps */
+
+/* Function isTemp tells the tmp<n> variables
+ * TmpVarBuild makes from the user's variables
+ */
+static int isTemp(char * name)
+{ if (strncmp(name,"tmp",3) != 0 || name[3] == '\0') return FALSE;
+  for (name += 3; *name != '\0'; name++)
+    if (! isdigit((unsigned char) *name)) return FALSE;
+  return TRUE;
+} /* isTemp */
+
+/* Function tempReg returns the register holding
+ * variable name, -1 if it is in memory
+ */
+static int tempReg(char * name)
+{ int r;
+  for (r = tr0; r < trLim; r++)
+    if ((regName[r] != NULL) && (strcmp(regName[r],name) == 0))
+      return r;
+  return -1;
+} /* tempReg */
 
 /* Procedure genStmt generates code at a statement node */
 static void genStmt( TreeNode * tree)
 { TreeNode * p1, * p2, * p3;
   int savedLoc1,savedLoc2,currentLoc;
-  int loc;
+  int loc, r, v;
   switch (tree->kind.stmt) {
 
       case IfK :
@@ -34,7 +98,8 @@ static void genStmt( TreeNode * tree)
          p2 = tree->child[1] ;
          p3 = tree->child[2] ;
          /* generate code for test expression */
-         cGen(p1);
+         v = genValue(p1,ac);
+         freeTemps();
          savedLoc1 = emitSkip(1) ;
          emitComment("if: jump to else belongs here");
          /* recurse on then part */
@@ -43,7 +108,7 @@ static void genStmt( TreeNode * tree)
          emitComment("if: jump to end belongs here");
          currentLoc = emitSkip(0) ;
          emitBackup(savedLoc1) ;
-         emitRM_Abs("JEQ",ac,currentLoc,"if: jmp to else");
+         emitRM_Abs("JEQ",v,currentLoc,"if: jmp to else");
          emitRestore() ;
          /* recurse on else part */
          cGen(p3);
@@ -63,18 +128,30 @@ static void genStmt( TreeNode * tree)
          /* generate code for body */
          cGen(p1);
          /* generate code for test */
-         cGen(p2);
-         emitRM_Abs("JEQ",ac,savedLoc1,"repeat: jmp back to body");
+         v = genValue(p2,ac);
+         freeTemps();
+         emitRM_Abs("JEQ",v,savedLoc1,"repeat: jmp back to body");
          if (TraceCode)  emitComment("<- repeat") ;
          break; /* repeat */
 
       case AssignK:
          if (TraceCode) emitComment("-> assign") ;
+         /* a tmp variable gets a register if one is free */
+         r = isTemp(tree->attr.attr.name) ? allocReg() : -1;
          /* generate code for rhs */
-         cGen(tree->child[0]);
-         /* now store value */
-         loc = st_lookup(tree->attr.attr.name);
-         emitRM("ST",ac,loc,gp,"assign: store value");
+         v = genValue(tree->child[0], (r >= 0) ? r : ac);
+         if (r >= 0)
+         { if (v != r) emitRM("ADDI",r,0,v,"assign: move to tmp register");
+           regName[r] = tree->attr.attr.name;
+           assignReg = r;
+         }
+         else
+         { /* now store value */
+           loc = st_lookup(tree->attr.attr.name);
+           emitRM("ST",v,loc,gp,"assign: store value");
+           assignReg = v;
+           if (! isTemp(tree->attr.attr.name)) freeTemps();
+         }
          if (TraceCode)  emitComment("<- assign") ;
          break; /* assign_k */
 
@@ -92,32 +169,41 @@ static void genStmt( TreeNode * tree)
          break;
       case WriteK:
          /* generate code for expression to write */
-         cGen(tree->child[0]);
+         v = genValue(tree->child[0],ac);
+         freeTemps();
          /* now output it */
-         emitRO("OUT",ac,0,0,"write ac");
+         emitRO("OUT",v,0,0,"write ac");
          break;
       default:
          break;
     }
 } /* genStmt */
 
-/* Procedure genExp generates code at an expression node */
-static void genExp( TreeNode * tree)
-{ int loc;
+/* Function genExp generates code at an expression node
+ * and returns the register left holding its value:
+ * target, or the register of a tmp variable
+ */
+static int genExp( TreeNode * tree, int target)
+{ int loc, r, a, b, left;
   TreeNode * p1, * p2;
+  Attr k;
   switch (tree->kind.exp) {
 
     case ConstK :
       if (TraceCode) emitComment("-> Const") ;
       /* gen code to load integer constant using LDC */
-      emitRM_LDC("LDC",ac,tree->attr,0,"load const");
+      emitRM_LDC("LDC",target,tree->attr,0,"load const");
       if (TraceCode)  emitComment("<- Const") ;
       break; /* ConstK */
     
     case IdK :
       if (TraceCode) emitComment("-> Id") ;
-      loc = st_lookup(tree->attr.attr.name);
-      emitRM("LD",ac,loc,gp,"load id value");
+      r = tempReg(tree->attr.attr.name);
+      if (r >= 0) target = r;
+      else
+      { loc = st_lookup(tree->attr.attr.name);
+        emitRM("LD",target,loc,gp,"load id value");
+      }
       if (TraceCode)  emitComment("<- Id") ;
       break; /* IdK */
 
@@ -125,77 +211,125 @@ static void genExp( TreeNode * tree)
          if (TraceCode) emitComment("-> Op") ;
          p1 = tree->child[0];
          p2 = tree->child[1];
-         /* gen code for ac = left arg */
-         cGen(p1);
-         /* gen code to push left operand */
-         emitRM("ST",ac,tmpOffset--,mp,"op: push left");
-         /* gen code for ac = right operand */
-         cGen(p2);
-         /* now load left operand */
-         emitRM("LD",ac1,++tmpOffset,mp,"op: load left");
+         if (ExtISA && (p1->nodekind == ExpK) && (p1->kind.exp == ConstK)
+             && ((tree->attr.attr.op == PLUS) || (tree->attr.attr.op == TIMES)))
+         { p1 = tree->child[1];
+           p2 = tree->child[0];
+         }
+         if (ExtISA && (p2->nodekind == ExpK) && (p2->kind.exp == ConstK)
+             && ((tree->attr.attr.op == PLUS) || (tree->attr.attr.op == MINUS)
+                 || (tree->attr.attr.op == TIMES)))
+         { /* gen code for the left arg and an immediate form */
+           a = genValue(p1,target);
+           k = p2->attr;
+           if (tree->attr.attr.op == MINUS)
+           { if (k.type == Int) k.attr.valint = -k.attr.valint;
+             else k.attr.valfloat = -k.attr.valfloat;
+           }
+           if (tree->attr.attr.op == TIMES)
+             emitRM_LDC("MULI",target,k,a,"op * const");
+           else emitRM_LDC("ADDI",target,k,a,"op + const");
+           if (TraceCode)  emitComment("<- Op") ;
+           break;
+         }
+         left = allocReg();
+         if (left >= 0)
+         { /* gen code for the left arg into a register of its own */
+           a = genValue(p1,left);
+           if (a != left)
+           { freeReg(left);
+             left = -1;
+           }
+           /* gen code for target = right operand */
+           b = genValue(p2,target);
+         }
+         else
+         { /* gen code for ac = left arg */
+           a = genValue(p1,target);
+           /* gen code to push left operand */
+           emitRM("ST",a,tmpOffset--,mp,"op: push left");
+           /* gen code for ac = right operand */
+           b = genValue(p2,target);
+           /* now load left operand */
+           emitRM("LD",ac1,++tmpOffset,mp,"op: load left");
+           a = ac1;
+         }
          switch (tree->attr.attr.op) {
             case PLUS :
-               emitRO("ADD",ac,ac1,ac,"op +");
+               emitRO("ADD",target,a,b,"op +");
                break;
             case MINUS :
-               emitRO("SUB",ac,ac1,ac,"op -");
+               emitRO("SUB",target,a,b,"op -");
                break;
             case XOR :
-               emitRO("XOR",ac,ac1,ac,"op ^");
+               emitRO("XOR",target,a,b,"op ^");
                break;
             case TIMES :
-               emitRO("MUL",ac,ac1,ac,"op *");
+               emitRO("MUL",target,a,b,"op *");
                break;
             case OVER :
-               emitRO("DIV",ac,ac1,ac,"op /");
+               emitRO("DIV",target,a,b,"op /");
                break;
             case LT :
-               emitRO("SUB",ac,ac1,ac,"op <") ;
-               emitRM("JLT",ac,2,pc,"br if true") ;
-               emitRM("LDC",ac,0,ac,"false case") ;
+               emitRO("SUB",target,a,b,"op <") ;
+               emitRM("JLT",target,2,pc,"br if true") ;
+               emitRM("LDC",target,0,target,"false case") ;
                emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
+               emitRM("LDC",target,1,target,"true case") ;
                break;
             case LET :
-               emitRO("SUB",ac,ac1,ac,"op <=") ;
-               emitRM("JLE",ac,2,pc,"br if true") ;
-               emitRM("LDC",ac,0,ac,"false case") ;
+               emitRO("SUB",target,a,b,"op <=") ;
+               emitRM("JLE",target,2,pc,"br if true") ;
+               emitRM("LDC",target,0,target,"false case") ;
                emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
+               emitRM("LDC",target,1,target,"true case") ;
                break;
             case GT :
-               emitRO("SUB",ac,ac1,ac,"op >") ;
-               emitRM("JGT",ac,2,pc,"br if true") ;
-               emitRM("LDC",ac,0,ac,"false case") ;
+               emitRO("SUB",target,a,b,"op >") ;
+               emitRM("JGT",target,2,pc,"br if true") ;
+               emitRM("LDC",target,0,target,"false case") ;
                emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
+               emitRM("LDC",target,1,target,"true case") ;
                break;
             case GET :
-               emitRO("SUB",ac,ac1,ac,"op >=") ;
-               emitRM("JGE",ac,2,pc,"br if true") ;
-               emitRM("LDC",ac,0,ac,"false case") ;
+               emitRO("SUB",target,a,b,"op >=") ;
+               emitRM("JGE",target,2,pc,"br if true") ;
+               emitRM("LDC",target,0,target,"false case") ;
                emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
+               emitRM("LDC",target,1,target,"true case") ;
                break;
             case EQ :
-               emitRO("SUB",ac,ac1,ac,"op ==") ;
-               emitRM("JEQ",ac,2,pc,"br if true");
-               emitRM("LDC",ac,0,ac,"false case") ;
+               emitRO("SUB",target,a,b,"op ==") ;
+               emitRM("JEQ",target,2,pc,"br if true");
+               emitRM("LDC",target,0,target,"false case") ;
                emitRM("LDA",pc,1,pc,"unconditional jmp") ;
-               emitRM("LDC",ac,1,ac,"true case") ;
+               emitRM("LDC",target,1,target,"true case") ;
                break;
             default:
                emitComment("BUG: Unknown operator");
                break;
          } /* case op */
+         if (left >= 0) freeReg(left);
          if (TraceCode)  emitComment("<- Op") ;
          break; /* OpK */
 
     default:
       break;
   }
+  return target;
 } /* genExp */
 
+/* Function genValue generates code for an operand,
+ * returning the register that holds it; tmp variable
+ * declarations leave the value of the last one
+ */
+static int genValue( TreeNode * tree, int target)
+{ if (tree == NULL) return target;
+  if (tree->nodekind == ExpK) return genExp(tree,target);
+  cGen(tree);
+  return assignReg;
+} /* genValue */
+
 /* Procedure cGen recursively generates code by
  * tree traversal
  */
@@ -206,7 +340,7 @@ static void cGen( TreeNode * tree)
         genStmt(tree);
         break;
       case ExpK:
-        genExp(tree);
+        genExp(tree,ac);
         break;
       default:
         break;
@@ -235,6 +369,7 @@ void codeGen(TreeNode * syntaxTree, char * codefile)
    emitRM("LD",mp,0,ac,"load maxaddress from location 0");
    emitRM("ST",ac,0,ac,"clear location 0");
    emitComment("End of standard prelude.");
+   if (ExtISA) emitComment("Extended ISA: registers 8 to 31, ADDI, MULI");
    /* generate code for TINY program */
    cGen(syntaxTree);
    /* finish */
@@ -29,6 +29,12 @@
 /* 2nd accumulator */
 #define  ac1 1
 
+/* tr0 .. trLim-1 = the registers the extended
+ * TM ISA adds (-mext), for temporaries
+ */
+#define  tr0 8
+#define  trLim 32
+
 /* code emitting utilities */
 
 /* Procedure emitComment prints a comment line 
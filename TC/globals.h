@@ -126,6 +126,12 @@ extern int TmpVarOptimize;
  */
 extern int ConstMerge;
 
+/* ExtISA = TRUE causes the code generator to target
+ * the extended TM ISA: temporaries kept in registers
+ * 8 to 31 and the immediate forms ADDI and MULI
+ */
+extern int ExtISA;
+
 /* Error = TRUE prevents further passes if an error occurs */
 extern int Error; 
 #endif
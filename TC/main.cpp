@@ -49,13 +49,21 @@ int NoMerge = FALSE;
 int TmpVarOptimize = TRUE;
 int ConstMerge = TRUE;
 
+/* allocate and set the target flag */
+int ExtISA = FALSE;
+
 int Error = FALSE;
 
 int main( int argc, char * argv[] )
 { TreeNode * syntaxTree;
   char pgm[120]; /* source code file name */
+  if ((argc == 3) && (strcmp(argv[1],"-mext") == 0))
+  { ExtISA = TRUE;
+    argv++;
+    argc--;
+  }
   if (argc != 2)
-    { fprintf(stderr,"usage: %s <filename>\n",argv[0]);
+    { fprintf(stderr,"usage: %s [-mext] <filename>\n",argv[0]);
       exit(1);
     }
   strcpy(pgm,argv[1]) ;
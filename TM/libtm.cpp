@@ -0,0 +1,242 @@
+/****************************************************/
+/* File: libtm.c                                    */
+/* Embeddable TM ("Tiny Machine") computers: each   */
+/* call binds the machine's context into the globals*/
+/* of tm.c and load.c and binds back the one before */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libtm.h"
+
+/********************************************/
+TmMachine::TmMachine ( int dsize, int isize )
+{ this->dsize = dsize ;
+  this->isize = isize ;
+  ctx = newContext(isize, dsize) ;
+  count = 0 ;
+  running = FALSE ;
+} /* TmMachine */
+
+/********************************************/
+TmMachine::TmMachine ( TmMachine * image )
+{ dsize = image->dsize ;
+  isize = image->isize ;
+  ctx = shareContext(image->ctx) ;
+  running = FALSE ;
+  reset () ;
+} /* TmMachine */
+
+/********************************************/
+TmMachine::~TmMachine ()
+{ freeContext(ctx) ;
+} /* ~TmMachine */
+
+/********************************************/
+TMCONTEXT * TmMachine::bind ()
+{ return bindContext(ctx) ;
+} /* bind */
+
+/********************************************/
+/* Function load reads the program from f   */
+/* into a machine with nothing loaded, as   */
+/* tm does, and closes f                    */
+/********************************************/
+int TmMachine::load ( FILE * f )
+{ TMCONTEXT * before = bind () ;
+  int ok ;
+  freeMachine () ;
+  iaddrSize = isize ;
+  daddrSize = dsize ;
+  pgm = f ;
+  ok = readInstructions () ;
+  fclose(f) ;
+  if ( ok )
+  { verifyInstructions () ;
+    decodeInstructions () ;
+    fuseInstructions () ;
+    threadInstructions () ;
+  }
+  else
+  { freeMachine () ;
+    iaddrSize = isize ;
+  }
+  count = 0 ;
+  bindContext(before) ;
+  return ok ;
+} /* load */
+
+/********************************************/
+int TmMachine::loadFile ( const char * name )
+{ FILE * f = fopen(name, "r") ;
+  if ( f == NULL )
+  { printf("file '%s' not found\n", name) ;
+    return FALSE ;
+  }
+  return load(f) ;
+} /* loadFile */
+
+/********************************************/
+/* Function loadText reads the program from */
+/* memory, through fmemopen where there is  */
+/* one and a temporary file elsewhere       */
+/********************************************/
+int TmMachine::loadText ( const char * text, size_t len )
+{ FILE * f ;
+#if defined(__unix__)
+  f = (len > 0) ? fmemopen((void *) text, len, "r") : fopen("/dev/null", "r") ;
+#else
+  f = tmpfile () ;
+  if ( f != NULL )
+  { fwrite(text, 1, len, f) ;
+    rewind(f) ;
+  }
+#endif
+  if ( f == NULL )
+  { printf("cannot read the program\n") ;
+    return FALSE ;
+  }
+  return load(f) ;
+} /* loadText */
+
+/********************************************/
+void TmMachine::reset ()
+{ TMCONTEXT * before = bind () ;
+  clearMachine () ;
+  inputEnded = FALSE ;
+  count = 0 ;
+  bindContext(before) ;
+} /* reset */
+
+/********************************************/
+STEPRESULT TmMachine::run ( long budget )
+{ TMCONTEXT * before = bind () ;
+  STEPRESULT result ;
+  long n ;
+  running = TRUE ;
+  if ( iMem == NULL ) result = srIMEM_ERR, n = 0 ;
+  else result = runFor(&n, budget) ;
+  running = FALSE ;
+  count += n ;
+  bindContext(before) ;
+  return result ;
+} /* run */
+
+/********************************************/
+STEPRESULT TmMachine::step ()
+{ TMCONTEXT * before = bind () ;
+  STEPRESULT result ;
+  running = TRUE ;
+  result = (iMem == NULL) ? srIMEM_ERR : stepTM () ;
+  running = FALSE ;
+  count++ ;
+  bindContext(before) ;
+  return result ;
+} /* step */
+
+/********************************************/
+void TmMachine::runLanes ( int n, char * text[], size_t len[], TMOUTHOOK out,
+                           void * user[], STEPRESULT result[], long count[],
+                           long budget )
+{ TMCONTEXT * before = bind () ;
+  int l ;
+  if ( iMem == NULL )
+    for (l = 0 ; l < n ; l++) result[l] = srIMEM_ERR, count[l] = 0 ;
+  else
+  { running = TRUE ;
+    ::runLanes(n, text, len, out, user, result, count, budget) ;
+    running = FALSE ;
+  }
+  clearMachine () ;
+  inputEnded = FALSE ;
+  this->count = 0 ;
+  bindContext(before) ;
+} /* runLanes */
+
+/********************************************/
+NUM TmMachine::reg ( int r )
+{ TMCONTEXT * before = bind () ;
+  NUM v ;
+  v.attr.valint = 0 ;
+  v.type = INT ;
+  if ( (r >= 0) && (r < NO_REGS) ) v = getReg(r) ;
+  bindContext(before) ;
+  return v ;
+} /* reg */
+
+/********************************************/
+void TmMachine::setReg ( int r, NUM v )
+{ TMCONTEXT * before = bind () ;
+  if ( (r >= 0) && (r < NO_REGS) && ! running )
+  { ::setReg(r, v) ;
+    unproveReg(r) ;
+  }
+  bindContext(before) ;
+} /* setReg */
+
+/********************************************/
+NUM TmMachine::mem ( int a )
+{ TMCONTEXT * before = bind () ;
+  NUM v ;
+  v.attr.valint = 0 ;
+  v.type = INT ;
+  if ( (dVal != NULL) && (a >= 0) && (a < daddrSize) ) v = getMem(a) ;
+  bindContext(before) ;
+  return v ;
+} /* mem */
+
+/********************************************/
+void TmMachine::setMem ( int a, NUM v )
+{ TMCONTEXT * before = bind () ;
+  if ( (dVal != NULL) && (a >= 0) && (a < daddrSize) ) ::setMem(a, v) ;
+  bindContext(before) ;
+} /* setMem */
+
+/********************************************/
+int TmMachine::memSize ()
+{ return dsize ;
+} /* memSize */
+
+/********************************************/
+int TmMachine::programSize ()
+{ TMCONTEXT * before = bind () ;
+  int size = (iMem == NULL) ? 0 : iaddrSize ;
+  bindContext(before) ;
+  return size ;
+} /* programSize */
+
+/********************************************/
+void TmMachine::onInput ( TMINHOOK f, void * user )
+{ TMCONTEXT * before = bind () ;
+  inHook = f ;
+  inUser = user ;
+  inputEnded = FALSE ;
+  bindContext(before) ;
+} /* onInput */
+
+/********************************************/
+void TmMachine::onOutput ( TMOUTHOOK f, void * user )
+{ TMCONTEXT * before = bind () ;
+  outHook = f ;
+  outUser = user ;
+  bindContext(before) ;
+} /* onOutput */
+
+/********************************************/
+void bufferOut ( void * user, NUM v )
+{ TMOUTBUF * p = (TMOUTBUF *) user ;
+  if ( p->len + OUTVALUE > p->cap )
+  { p->text = (char *) growArray(p->text, (int) p->cap,
+                                 (int) (2 * p->cap + 4 * OUTVALUE), 1) ;
+    p->cap = 2 * p->cap + 4 * OUTVALUE ;
+  }
+  p->len = formatOut(p->text + p->len, v) - p->text ;
+} /* bufferOut */
+
+/********************************************/
+void TmMachine::messages ( FILE * f )
+{ TMCONTEXT * before = bind () ;
+  msgOut = f ;
+  bindContext(before) ;
+} /* messages */
@@ -0,0 +1,341 @@
+/****************************************************/
+/* File: libtm.h                                    */
+/* Embeddable TM ("Tiny Machine") computers: each   */
+/* TmMachine has its own program, registers, dMem   */
+/* and IN/OUT hooks, so that any number of them can */
+/* run in one process                               */
+/****************************************************/
+
+#ifndef _LIBTM_H_
+#define _LIBTM_H_
+
+#include <stddef.h>
+#include "tm.h"
+
+/* the values of OUT gathered in memory, formatted
+ * as formatOut does: len bytes at text, which has
+ * room for cap; all zero when empty
+ */
+typedef struct {
+   char * text ;
+   size_t len, cap ;
+   } TMOUTBUF;
+
+/* Procedure bufferOut is an OUT hook whose user is
+ * a TMOUTBUF, to which it adds v
+ */
+void bufferOut ( void * user, NUM v ) ;
+
+class TmMachine {
+public:
+  /* a machine with dsize words of dMem and isize of
+   * iMem, or iMem sized from the program if isize is 0
+   */
+  TmMachine ( int dsize = DADDR_SIZE, int isize = 0 ) ;
+
+  /* a machine with registers and dMem of its own
+   * running the program of image, which is shared,
+   * not copied: image must stay loaded while it is
+   * used, and not be in use by another thread while
+   * it is made. Machines sharing a program can then
+   * run at once in different threads
+   */
+  explicit TmMachine ( TmMachine * image ) ;
+  ~TmMachine () ;
+
+  /* Functions loadFile and loadText load a .tm
+   * program, replacing any loaded before, from a file
+   * or from len bytes of text, and clear the machine;
+   * FALSE (after a message) if it cannot be read
+   */
+  int loadFile ( const char * name ) ;
+  int loadText ( const char * text, size_t len ) ;
+
+  /* Procedure reset clears the registers and dMem,
+   * except mem(0) = memSize()-1, for a new run
+   */
+  void reset () ;
+
+  /* Function run executes from reg(PC_REG) until
+   * HALT or a fault or, if budget > 0, the first
+   * jump after budget instructions, returning srOKAY
+   * if the budget ran out; step executes one
+   * instruction. Either can be called again to go on
+   */
+  STEPRESULT run ( long budget = 0 ) ;
+  STEPRESULT step () ;
+
+  /* Procedure runLanes runs the program from the
+   * start on n inputs at once, up to MAXLANES, as
+   * ::runLanes does, each lane stopping as run does
+   * if budget > 0, and then resets the machine
+   */
+  void runLanes ( int n, char * text[], size_t len[], TMOUTHOOK out,
+                  void * user[], STEPRESULT result[], long count[],
+                  long budget = 0 ) ;
+
+  /* instructions executed since the load or reset */
+  long executed () const { return count ; }
+
+  /* the registers and dMem, tagged INT or FLOAT;
+   * reads out of range give int 0, writes out of
+   * range are ignored. Inside a hook of this
+   * machine, registers read as they were when the
+   * run began and setReg is ignored. A register
+   * set to a value the program itself could not
+   * give it makes the machine decode the program
+   * again, with no register assumed known
+   */
+  NUM reg ( int r ) ;
+  void setReg ( int r, NUM v ) ;
+  NUM mem ( int a ) ;
+  void setMem ( int a, NUM v ) ;
+  int memSize () ;
+  int programSize () ;
+
+  /* IN and OUT call f with user; with no hook, they
+   * use standard input and output as tm does
+   */
+  void onInput ( TMINHOOK f, void * user ) ;
+  void onOutput ( TMOUTHOOK f, void * user ) ;
+
+  /* where HALT and input errors are reported; NULL,
+   * the default, for nowhere
+   */
+  void messages ( FILE * f ) ;
+
+  /* Function bind makes this machine the one the
+   * globals of tm.h hold, for the rest of the TM
+   * code, and returns the context bound before
+   */
+  TMCONTEXT * bind () ;
+
+private:
+  TMCONTEXT * ctx ;
+  int dsize, isize ;
+  long count ;
+  int running ;            /* in run, step or runLanes */
+
+  int load ( FILE * f ) ;
+  TmMachine ( const TmMachine & ) ;               /* not copied */
+  TmMachine & operator= ( const TmMachine & ) ;
+} ;
+
+/* state of a session of a TmScheduler */
+typedef enum {
+   tmREADY,     /* in the run queue */
+   tmWAITING,   /* at an IN, until input is fed or closed */
+   tmDONE       /* stopped: HALT, a fault, or End of Input after close */
+   } TMSTATE;
+
+typedef struct tmsession TMSESSION;
+
+/* Many TmMachines on one thread: each session runs
+ * for a quantum of instructions (to the next jump)
+ * at a time, round robin, and waits at an IN with
+ * no input queued, without blocking the others
+ */
+class TmScheduler {
+public:
+  TmScheduler ( long quantum = 10000 ) ;
+  ~TmScheduler () ;
+
+  /* Function add makes m a session, ready to run
+   * from its pc, and returns its number; the
+   * scheduler owns the IN hook of m but not m
+   */
+  int add ( TmMachine * m ) ;
+
+  /* Procedure feed queues v for the INs of session
+   * s, waking it if it waits; close ends its input,
+   * so an IN with none queued ends it with
+   * srNO_INPUT
+   */
+  void feed ( int s, NUM v ) ;
+  void close ( int s ) ;
+
+  /* Function runSlice runs the session at the head
+   * of the run queue for one quantum and returns
+   * its number, or -1 if no session is ready; run
+   * runs slices until none is, returning how many
+   */
+  int runSlice () ;
+  long run () ;
+
+  TMSTATE state ( int s ) ;
+  STEPRESULT result ( int s ) ;    /* of a tmDONE session */
+  TmMachine * machine ( int s ) ;
+  int ready () const { return nReady ; }
+
+  /* Procedure remove forgets session s, whose
+   * number may then be reused
+   */
+  void remove ( int s ) ;
+
+private:
+  long quantum ;
+  TMSESSION ** session ;   /* by number, NULL if free */
+  int nSessions, maxSessions ;
+  int * runQueue ;         /* ring of maxSessions numbers */
+  int head, nReady ;
+
+  void makeReady ( int s ) ;
+  TmScheduler ( const TmScheduler & ) ;           /* not copied */
+  TmScheduler & operator= ( const TmScheduler & ) ;
+} ;
+
+typedef struct tmjob TMJOB;
+typedef struct tmworker TMWORKER;
+
+/* Every program of a batch run on every input file by
+ * a pool of threads: each program is loaded and
+ * decoded once and shared, read-only, by machines of
+ * each thread. The jobs are dealt out in order to
+ * deques, one per thread, and a thread with none
+ * left steals from the others
+ */
+class TmBatch {
+public:
+  /* workers threads, or one per processor if 0, with
+   * machines of dsize words of dMem and isize of iMem
+   */
+  TmBatch ( int workers = 0, int dsize = DADDR_SIZE, int isize = 0 ) ;
+  ~TmBatch () ;
+
+  /* Function addProgram loads the .tm program in file
+   * name, FALSE (after a message) if it cannot be read;
+   * addInput adds a file of IN values, read as tm
+   * --run reads standard input
+   */
+  int addProgram ( const char * name ) ;
+  void addInput ( const char * name ) ;
+
+  /* Procedure lanes has up to n jobs of a program,
+   * taken together, run at once by runLanes; 1, the
+   * default, runs each alone
+   */
+  void lanes ( int n ) ;
+
+  /* Procedure budget stops each job at the first
+   * jump after n instructions, as run(n) does; 0, the
+   * default, runs each to its end
+   */
+  void budget ( long n ) ;
+
+  /* Function run runs each program on each input, the
+   * values of OUT kept by job in outFormat, and returns
+   * how many jobs did not halt
+   */
+  int run () ;
+
+  /* the jobs, by program and then by input */
+  int jobs () const { return nJobs ; }
+  STEPRESULT result ( int j ) ;
+  long executed ( int j ) ;
+  const char * output ( int j, size_t * len ) ;
+
+  /* Procedure report writes for each job a line with
+   * its program, input, result (Budget spent if the
+   * budget ran out) and instruction count, followed by
+   * its output
+   */
+  void report ( FILE * f ) ;
+
+private:
+  int nWorkers, nPool, nLanes, dsize, isize ;
+  long runBudget ;         /* 0 for none */
+  TmMachine ** image ;     /* by program */
+  char ** programName ;
+  int nPrograms ;
+  char ** inputName ;
+  int nInputs ;
+  TMJOB * job ;
+  int nJobs ;
+  TMWORKER * worker ;      /* the pool, while running */
+
+  static void * work ( void * arg ) ;
+  TmBatch ( const TmBatch & ) ;                   /* not copied */
+  TmBatch & operator= ( const TmBatch & ) ;
+} ;
+
+/* Function forkServe serves runs of the program of
+ * m, reported as name: for each line of requests,
+ * naming an input file, a child process is forked
+ * that runs m on it, as TmBatch does, and writes its
+ * report to standard output in one piece at the end.
+ * Each child is waited for before the next request is
+ * read, so runs never overlap. m must be loaded and not
+ * yet run; the children share its pages copy-on-write
+ * and start from it as it is, with no load or reset.
+ * Each stops after budget instructions (at the next
+ * jump) if budget > 0, and is killed after cpu
+ * seconds of processor time if cpu > 0. Returns how
+ * many runs did not halt
+ */
+int forkServe ( TmMachine * m, const char * name, FILE * requests,
+                long budget, long cpu ) ;
+
+/* A job for tm --serve, on a Unix socket: a TMREQUEST
+ * and then programLen bytes of .tm text and inputLen
+ * bytes of IN values. With no text, the program is
+ * the one cached with hash. The reply is a TMREPLY
+ * and then outLen bytes of what OUT wrote, in
+ * outFormat; result is srOKAY if the budget ran out,
+ * and TMUNKNOWN if the program is not cached and not
+ * sent, or does not load. A request with programLen
+ * or inputLen over TMMAXREQUEST gets TMUNKNOWN and
+ * its connection is closed, as is one that sends
+ * nothing for TMSERVETIMEOUT seconds. Integers are in
+ * the byte order of the machine
+ */
+typedef struct {
+   unsigned int programLen, inputLen ;
+   unsigned long long hash ;
+   long long budget ;        /* 0 for the server's */
+   } TMREQUEST;
+
+typedef struct {
+   int result ;              /* a STEPRESULT or TMUNKNOWN */
+   unsigned int outLen ;
+   unsigned long long hash ; /* of the program */
+   long long count ;         /* instructions executed */
+   } TMREPLY;
+
+#define TMUNKNOWN  -1
+#define TMMAXREQUEST  (64 << 20)   /* bytes of text or input of a job */
+#define TMSERVEBUDGET  100000000L  /* of a job if neither it nor the server sets one */
+#define TMSERVETIMEOUT 5           /* seconds a connection may send nothing */
+
+/* Function serveTM serves jobs on the socket path,
+ * one connection at a time, with up to cacheSize
+ * programs kept decoded for machines of dsize and
+ * isize words, and budget, if > 0, the most any job
+ * may run, TMSERVEBUDGET if neither it nor the job
+ * sets one; it returns only if the socket fails.
+ * submitTM sends the program in file name, by hash
+ * and then by text if need be, and the input file
+ * inputName, and prints the reply as TmBatch does
+ */
+int serveTM ( const char * path, int cacheSize, long budget,
+              int dsize, int isize ) ;
+int submitTM ( const char * path, const char * name, const char * inputName,
+               long budget ) ;
+
+/* Function hashText returns the 64-bit FNV-1a hash
+ * of len bytes at text
+ */
+unsigned long long hashText ( const char * text, size_t len ) ;
+
+/* Function readText returns the contents of file
+ * name, storing its length in *len; NULL if it
+ * cannot be read
+ */
+char * readText ( const char * name, size_t * len ) ;
+
+/* Function growArray returns p, of n elements of
+ * size bytes, reallocated to hold m, the new ones
+ * zeroed
+ */
+void * growArray ( void * p, int n, int m, size_t size ) ;
+
+#endif
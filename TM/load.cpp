@@ -0,0 +1,792 @@
+/****************************************************/
+/* File: load.c                                     */
+/* Program loader for the TM ("Tiny Machine")       */
+/* computer                                         */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "tm.h"
+
+#if defined(__linux__) && defined(__LP64__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
+#endif
+
+/* passes of verifyInstructions before a register
+ * whose range still grows is taken as unknown
+ */
+#define   WIDEN_PASSES  9
+
+/******** vars ********/
+TMLOCAL int iaddrSize = 0;
+TMLOCAL int daddrSize = DADDR_SIZE;
+int hugePages = FALSE;
+int guardMemory = FALSE;
+
+TMLOCAL INSTRUCTION * iMem = NULL;
+TMLOCAL int iMemSize = 0;
+TMLOCAL WORD regVal [NO_REGS];
+TMLOCAL unsigned regFloat;
+TMLOCAL WORD * dVal = NULL;
+TMLOCAL char * dGuardEnd = NULL;
+TMLOCAL unsigned * dFloat = NULL;
+
+TMLOCAL RANGE regRange [NO_REGS];
+TMLOCAL char * addrProven = NULL;
+
+char * opCodeTab[]
+        = {"HALT","IN","OUT","ADD","SUB","XOR","MUL","DIV","????",
+            /* RR opcodes */
+           "LD","ST","????", /* RM opcodes */
+           "LDA","LDC","ADDI","MULI","JLT","JLE","JGT","JGE","JEQ","JNE","????"
+           /* RA opcodes */
+          };
+
+char * stepResultTab[]
+        = {"OK","Halted","Instruction Memory Fault",
+           "Data Memory Fault","Division by 0","Type Error","Memory FLoat",
+           "Breakpoint","Watchpoint","End of Input"
+          };
+
+TMLOCAL FILE *pgm  ;
+
+TMLOCAL char in_Line[LINESIZE] ;
+TMLOCAL int lineLen ;
+TMLOCAL int inCol  ;
+TMLOCAL int num  ;
+TMLOCAL NUM _num  ;
+TMLOCAL char word[WORDSIZE] ;
+TMLOCAL char ch  ;
+
+/********************************************/
+int opClass( int c )
+{ if      ( c <= opRRLim) return ( opclRR );
+  else if ( c <= opRMLim) return ( opclRM );
+  else                    return ( opclRA );
+} /* opClass */
+
+/********************************************/
+/* Function printInstruction prints the     */
+/* instruction at loc to f, with no newline */
+/* and returns the number of characters     */
+/********************************************/
+int printInstruction ( FILE * f, int loc )
+{ int len ;
+  len = fprintf(f, "%6s%3d,", opCodeTab[iMem[loc].iop], iMem[loc].iarg1);
+  if (iMem[loc].iarg2.type == INT)
+    len += fprintf(f, (opClass(iMem[loc].iop) == opclRR) ? "%1d" : "%3d",
+                   iMem[loc].iarg2.attr.valint);
+  else len += fprintf(f, "%.3f", iMem[loc].iarg2.attr.valfloat);
+  if (opClass(iMem[loc].iop) == opclRR)
+    len += fprintf(f, ",%1d", iMem[loc].iarg3);
+  else len += fprintf(f, "(%1d)", iMem[loc].iarg3);
+  return len ;
+} /* printInstruction */
+
+/********************************************/
+/* Function sizeOption sets iaddrSize for   */
+/* "-i n" and daddrSize for "-d n", and     */
+/* returns FALSE for any other option       */
+/********************************************/
+int sizeOption ( char * opt, char * arg )
+{ long n = strtol(arg, NULL, 10) ;
+  if ( strcmp(opt, "-i") == 0 )
+  { if ( (n < 1) || (n > IADDR_MAX) )
+    { printf("-i must be 1 to %d\n", IADDR_MAX) ;
+      exit(1) ;
+    }
+    iaddrSize = (int) n ;
+    return TRUE ;
+  }
+  if ( strcmp(opt, "-d") == 0 )
+  { if ( (n < 1) || (n > DADDR_MAX) )
+    { printf("-d must be 1 to %d\n", DADDR_MAX) ;
+      exit(1) ;
+    }
+    daddrSize = (int) n ;
+    return TRUE ;
+  }
+  return FALSE ;
+} /* sizeOption */
+
+/********************************************/
+void * mapZero ( size_t size )
+{ void * p ;
+#if defined(__linux__) && defined(__LP64__)
+  p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+           MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) ;
+  if ( p == MAP_FAILED ) p = NULL ;
+#ifdef MADV_HUGEPAGE
+  else if ( hugePages && (size >= ((size_t) 2 << 20)) )
+    madvise(p, size, MADV_HUGEPAGE) ;
+#endif
+#else
+  p = calloc(size, 1) ;
+#endif
+  if ( p == NULL )
+  { printf("out of memory\n") ;
+    exit(1) ;
+  }
+  return p ;
+} /* mapZero */
+
+/********************************************/
+void unmapZero ( void * p, size_t size )
+{ if ( p == NULL ) return ;
+#if defined(__linux__) && defined(__LP64__)
+  munmap(p, size) ;
+#else
+  free(p) ;
+#endif
+} /* unmapZero */
+
+/********************************************/
+/* Procedure clearZero hands the pages      */
+/* wholly inside the range back with        */
+/* MADV_DONTNEED, which refills them with   */
+/* zeros on the next touch, and clears the  */
+/* partial pages at either end              */
+/********************************************/
+void clearZero ( void * p, size_t size )
+{ char * lo = (char *) p, * hi = lo + size ;
+#if defined(__linux__) && defined(__LP64__)
+  size_t page = sysconf(_SC_PAGESIZE) ;
+  char * a = (char *) (((size_t) lo + page - 1) / page * page) ;
+  char * b = (char *) ((size_t) hi / page * page) ;
+  if ( (b > a) && (madvise(a, b - a, MADV_DONTNEED) == 0) )
+  { memset(lo, 0, a - lo) ;
+    memset(b, 0, hi - b) ;
+    return ;
+  }
+#endif
+  memset(lo, 0, size) ;
+} /* clearZero */
+
+/********************************************/
+/* Procedure allocMemory allocates dVal. On */
+/* 64-bit Linux with guardMemory set it is  */
+/* placed at the end of its pages and       */
+/* followed by DGUARD_SIZE bytes of         */
+/* PROT_NONE, so that indexing it with any  */
+/* unsigned 32-bit value past its end       */
+/* faults instead of reaching other data.   */
+/* dGuardEnd stays NULL without the guard   */
+/********************************************/
+void allocMemory (void)
+{ size_t size = (size_t) daddrSize * sizeof(WORD) ;
+#if defined(__linux__) && defined(__LP64__)
+  size_t page = sysconf(_SC_PAGESIZE) ;
+  size_t rw = (size + page - 1) / page * page ;
+  char * base = ! guardMemory ? (char *) MAP_FAILED
+                : (char *) mmap(NULL, rw + DGUARD_SIZE, PROT_NONE,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0) ;
+  if ( (base != (char *) MAP_FAILED)
+       && (mprotect(base, rw, PROT_READ | PROT_WRITE) == 0) )
+  { dVal = (WORD *) (base + rw - size) ;
+    dGuardEnd = base + rw + DGUARD_SIZE ;
+  }
+  else
+  { if ( base != (char *) MAP_FAILED ) munmap(base, rw + DGUARD_SIZE) ;
+    dVal = (WORD *) mapZero(size) ;
+  }
+#else
+  dVal = (WORD *) mapZero(size) ;
+#endif
+  dFloat = (unsigned *) mapZero((daddrSize + 31) / 32 * sizeof(unsigned)) ;
+} /* allocMemory */
+
+/********************************************/
+/* Procedure freeMemory frees dVal, with    */
+/* its guard, and dFloat                    */
+/********************************************/
+void freeMemory (void)
+{ size_t size = (size_t) daddrSize * sizeof(WORD) ;
+  if ( dVal == NULL ) return ;
+#if defined(__linux__) && defined(__LP64__)
+  size_t page = sysconf(_SC_PAGESIZE) ;
+  size_t rw = (size + page - 1) / page * page ;
+  if ( dGuardEnd != NULL )
+    munmap(dGuardEnd - DGUARD_SIZE - rw, rw + DGUARD_SIZE) ;
+  else
+#endif
+  unmapZero(dVal, size) ;
+  unmapZero(dFloat, (daddrSize + 31) / 32 * sizeof(unsigned)) ;
+  dVal = NULL ;
+  dGuardEnd = NULL ;
+  dFloat = NULL ;
+} /* freeMemory */
+
+/********************************************/
+void clearMachine (void)
+{ if ( dVal == NULL ) allocMemory () ;
+  memset(regVal, 0, sizeof(regVal)) ;
+  regFloat = 0 ;
+  clearZero(dVal, (size_t) daddrSize * sizeof(WORD)) ;
+  clearZero(dFloat, (daddrSize + 31) / 32 * sizeof(unsigned)) ;
+  dVal[0].valint = daddrSize - 1 ;
+} /* clearMachine */
+
+/********************************************/
+void getCh (void)
+{ if (++inCol < lineLen)
+  ch = in_Line[inCol] ;
+  else ch = ' ' ;
+} /* getCh */
+
+/********************************************/
+int getLine (void)
+{ if (fgets(in_Line, LINESIZE, stdin) == NULL)
+  { in_Line[0] = '\0' ;
+    lineLen = 0 ;
+    return FALSE ;
+  }
+  lineLen = strlen(in_Line) ;
+  if ((lineLen > 0) && (in_Line[lineLen-1] == '\n'))
+    in_Line[--lineLen] = '\0' ;
+  return TRUE ;
+} /* getLine */
+
+/********************************************/
+int nonBlank (void)
+{ while ((inCol < lineLen)
+         && (in_Line[inCol] == ' ') )
+    inCol++ ;
+  if (inCol < lineLen)
+  { ch = in_Line[inCol] ;
+    return TRUE ; }
+  else
+  { ch = ' ' ;
+    return FALSE ; }
+} /* nonBlank */
+
+/********************************************/
+int getNum (void)
+{
+  char sca[25]; int cntsca;
+  int temp = FALSE;
+  float tmp;
+  _num.attr.valfloat = 0 ; _num.type = INT;
+  do
+  {
+    cntsca = 0; tmp = 0;
+    while ( nonBlank() && ((ch == '+') || (ch == '-')) )
+    { temp = FALSE ;
+      if (ch == '-')  sca[cntsca++] = ch ;
+      getCh();
+    }
+    nonBlank();
+    while (isdigit(ch) || (ch == '.' || ch == 'E' || ch == 'e'))
+    { temp = TRUE ;
+      sca[cntsca++] = ch ;
+      getCh();
+    }
+    sca[cntsca] = '\0';
+    sscanf(sca, "%f", &tmp) ;
+    _num.attr.valfloat += tmp;
+  } while ( (nonBlank()) && ((ch == '+') || (ch == '-')) ) ;
+  _num.type = FLOAT;
+  if (_num.attr.valfloat == (int)_num.attr.valfloat)
+  {
+    _num.attr.valint = (int)_num.attr.valfloat;
+    _num.type = INT;
+    num = _num.attr.valint;
+  }
+  return temp;
+} 
+/*
+int getNum (void)
+{ int sign;
+  int term;
+  int temp = FALSE;
+  num = 0;
+  do
+  { sign = 1;
+    while ( nonBlank() && ((ch == '+') || (ch == '-')) )
+    { temp = FALSE ;
+      if (ch == '-')  sign = - sign ;
+      getCh();
+    }
+    term = 0 ;
+    nonBlank();
+    while (isdigit(ch))
+    { temp = TRUE ;
+      term = term * 10 + ( ch - '0' ) ;
+      getCh();
+    }
+    num = num + (term * sign) ;
+  } while ( (nonBlank()) && ((ch == '+') || (ch == '-')) ) ;
+  return temp;
+}
+*/
+/********************************************/
+int getWord (void)
+{ int temp = FALSE;
+  int length = 0;
+  if (nonBlank ())
+  { while (isalnum(ch))
+    { if (length < WORDSIZE-1) word [length++] =  ch ;
+      getCh() ;
+    }
+    word[length] = '\0';
+    temp = (length != 0);
+  }
+  return temp;
+} /* getWord */
+
+/********************************************/
+int skipCh ( char c  )
+{ int temp = FALSE;
+  if ( nonBlank() && (ch == c) )
+  { getCh();
+    temp = TRUE;
+  }
+  return temp;
+} /* skipCh */
+
+/********************************************/
+int atEOL(void)
+{ return ( ! nonBlank ());
+} /* atEOL */
+
+/********************************************/
+int error( char * msg, int lineNo, int instNo)
+{ printf("Line %d",lineNo);
+  if (instNo >= 0) printf(" (Instruction %d)",instNo);
+  printf("   %s\n",msg);
+  return FALSE;
+} /* error */
+
+/******** fast loader ********/
+
+/* files from this size up are parsed by several threads */
+#define   LOAD_PARALLEL  (4 << 20)
+#define   LOAD_THREADS   16
+
+/* perfect hash of the opcode names: slot of a word of
+ * len >= 2 characters, and the opcode in each slot or -1
+ */
+#define   OPHASH(w, len)  \
+  (((w)[0] * 9 + (w)[(len)-1] * 29 + (w)[1] + (len)) & 31)
+int opHash [32] ;
+
+#if defined(__linux__) && defined(__LP64__)
+/* Procedure hashOpcodes fills opHash, once for
+ * all threads
+ */
+pthread_once_t opHashed = PTHREAD_ONCE_INIT ;
+
+void hashOpcodes (void)
+{ int i ;
+  for (i = 0 ; i < 32 ; i++) opHash[i] = -1 ;
+  for (i = 0 ; i < opRALim ; i++)
+    if ( opCodeTab[i][0] != '?' )
+      opHash[OPHASH(opCodeTab[i], (int) strlen(opCodeTab[i]))] = i ;
+} /* hashOpcodes */
+#endif
+
+/* the instructions parsed from one chunk of whole lines,
+ * in file order, or stored straight into iMem when the
+ * file is one chunk
+ */
+typedef struct {
+      char * start, * end ;
+      int limit ;
+      int direct ;
+      int * locs ;
+      INSTRUCTION * ins ;
+      int n, cap ;
+      int top ;
+      int ok ;   /* FALSE: a line needs readInstructions */
+   } LOADCHUNK;
+
+/********************************************/
+/* Function fastNum parses an int or float  */
+/* at *pp, the way getNum reads a plain     */
+/* number, into *v; FALSE for anything      */
+/* getNum may read otherwise, such as sums  */
+/********************************************/
+int fastNum ( char ** pp, char * e, NUM * v )
+{ char * p = *pp, * q ;
+  char tok[32], * end ;
+  int neg = FALSE, len ;
+  long i ;
+  if ( (p < e) && ((*p == '-') || (*p == '+')) )
+  { neg = (*p == '-') ;
+    for (p++ ; (p < e) && (*p == ' ') ; p++) ;
+  }
+  for (q = p, i = 0 ; (q < e) && isdigit((unsigned char) *q) && (q - p < 9) ; q++)
+    i = i * 10 + (*q - '0') ;
+  if ( (q > p) && ((q == e) || ! (isdigit((unsigned char) *q)
+                   || (*q == '.') || (*q == 'e') || (*q == 'E'))) )
+  { /* as getNum, through a float */
+    v->attr.valint = (int) (float) (neg ? -i : i) ;
+    v->type = INT ;
+  }
+  else
+  { for (q = p, len = 0 ; (q < e) && (len < 31) && (isdigit((unsigned char) *q)
+           || (*q == '.') || (*q == 'e') || (*q == 'E')) ; q++)
+      tok[len++] = *q ;
+    tok[len] = '\0' ;
+    if ( (len == 0) || (len == 31) ) return FALSE ;
+    v->attr.valfloat = strtof(tok, &end) ;
+    if ( end != tok + len ) return FALSE ;
+    if ( neg ) v->attr.valfloat = - v->attr.valfloat ;
+    v->type = FLOAT ;
+    if ( v->attr.valfloat == (int) v->attr.valfloat )
+    { v->attr.valint = (int) v->attr.valfloat ;
+      v->type = INT ;
+    }
+  }
+  /* getNum would go on to add a following term */
+  for (p = q ; (p < e) && (*p == ' ') ; p++) ;
+  if ( (p < e) && ((*p == '+') || (*p == '-')) ) return FALSE ;
+  *pp = p ;
+  return TRUE ;
+} /* fastNum */
+
+/* Function fastReg parses a register number at *pp */
+int fastReg ( char ** pp, char * e, int * r )
+{ NUM v ;
+  while ( (*pp < e) && (**pp == ' ') ) (*pp)++ ;
+  if ( (*pp == e) || ! isdigit((unsigned char) **pp) ) return FALSE ;
+  if ( ! fastNum(pp, e, &v) || (v.type != INT)
+       || (v.attr.valint < 0) || (v.attr.valint >= NO_REGS) ) return FALSE ;
+  *r = v.attr.valint ;
+  return TRUE ;
+} /* fastReg */
+
+/* Function fastCh skips blanks and the character c at *pp */
+int fastCh ( char ** pp, char * e, char c )
+{ while ( (*pp < e) && (**pp == ' ') ) (*pp)++ ;
+  if ( (*pp == e) || (**pp != c) ) return FALSE ;
+  (*pp)++ ;
+  return TRUE ;
+} /* fastCh */
+
+/********************************************/
+/* Function parseChunk parses the lines of  */
+/* a chunk as readInstructions would, and   */
+/* clears ok at the first line it cannot    */
+/* take: errors, sums, long lines           */
+/********************************************/
+void * parseChunk ( void * arg )
+{ LOADCHUNK * c = (LOADCHUNK *) arg ;
+  char * p, * e, * w ;
+  INSTRUCTION ins ;
+  int loc, op, len ;
+  c->ok = FALSE ;
+  for (p = c->start ; p < c->end ; p = e + 1)
+  { e = (char *) memchr(p, '\n', c->end - p) ;
+    if ( e == NULL ) e = c->end ;
+    if ( e - p >= LINESIZE - 4 ) return NULL ;   /* fgets would split it */
+    while ( (p < e) && (*p == ' ') ) p++ ;
+    if ( (p == e) || (*p == '*') ) continue ;
+    if ( ! isdigit((unsigned char) *p) || ! fastNum(&p, e, &ins.iarg2)
+         || (ins.iarg2.type != INT) ) return NULL ;
+    loc = ins.iarg2.attr.valint ;
+    if ( (loc < 0) || (loc >= c->limit) || ! fastCh(&p, e, ':') ) return NULL ;
+    while ( (p < e) && (*p == ' ') ) p++ ;
+    for (w = p ; (p < e) && isalnum((unsigned char) *p) ; p++) ;
+    len = p - w ;
+    if ( (len < 2) || (len > 4) ) return NULL ;
+    op = opHash[OPHASH(w, len)] ;
+    if ( (op < 0) || (strncmp(opCodeTab[op], w, len) != 0)
+         || (opCodeTab[op][len] != '\0') ) return NULL ;
+    ins.iop = op ;
+    if ( ! fastReg(&p, e, &ins.iarg1) || ! fastCh(&p, e, ',') ) return NULL ;
+    if ( opClass(op) == opclRR )
+    { if ( ! fastReg(&p, e, &ins.iarg3) || ! fastCh(&p, e, ',') ) return NULL ;
+      ins.iarg2.attr.valint = ins.iarg3 ;
+      ins.iarg2.type = INT ;
+    }
+    else
+    { while ( (p < e) && (*p == ' ') ) p++ ;
+      if ( ! fastNum(&p, e, &ins.iarg2) ) return NULL ;
+      if ( ! fastCh(&p, e, '(') && ! fastCh(&p, e, ',') ) return NULL ;
+    }
+    if ( ! fastReg(&p, e, &ins.iarg3) ) return NULL ;
+    if ( loc >= c->top ) c->top = loc + 1 ;
+    if ( c->direct )
+    { iMem[loc] = ins ;
+      continue ;
+    }
+    if ( c->n == c->cap )
+    { c->cap = 2 * c->cap + 1024 ;
+      c->locs = (int *) realloc(c->locs, c->cap * sizeof(int)) ;
+      c->ins = (INSTRUCTION *) realloc(c->ins, c->cap * sizeof(INSTRUCTION)) ;
+      if ( (c->locs == NULL) || (c->ins == NULL) ) return NULL ;
+    }
+    c->locs[c->n] = loc ;
+    c->ins[c->n++] = ins ;
+  }
+  c->ok = TRUE ;
+  return NULL ;
+} /* parseChunk */
+
+/********************************************/
+/* Function fastLoad loads the program from */
+/* pgm, mapped, split at line boundaries    */
+/* among threads when it is large, into     */
+/* iMem below limit. FALSE if pgm is not a  */
+/* plain file or has lines only             */
+/* readInstructions can read, which then    */
+/* rewrites any instruction stored here     */
+/********************************************/
+int fastLoad ( int limit, int * top )
+{
+#if defined(__linux__) && defined(__LP64__)
+  LOADCHUNK chunk [LOAD_THREADS] ;
+  pthread_t thread [LOAD_THREADS] ;
+  struct stat st ;
+  char * text, * p ;
+  int nChunks, i, j, ok ;
+  long cpus ;
+  if ( (fstat(fileno(pgm), &st) != 0) || ! S_ISREG(st.st_mode) || (st.st_size == 0) )
+    return FALSE ;
+  text = (char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(pgm), 0) ;
+  if ( text == (char *) MAP_FAILED ) return FALSE ;
+  pthread_once(&opHashed, hashOpcodes) ;
+  cpus = sysconf(_SC_NPROCESSORS_ONLN) ;
+  nChunks = (int) (st.st_size / LOAD_PARALLEL) + 1 ;
+  if ( nChunks > cpus ) nChunks = (int) cpus ;
+  if ( nChunks > LOAD_THREADS ) nChunks = LOAD_THREADS ;
+  if ( nChunks < 1 ) nChunks = 1 ;
+  for (i = 0, p = text ; i < nChunks ; i++)
+  { memset(&chunk[i], 0, sizeof(LOADCHUNK)) ;
+    chunk[i].start = p ;
+    p = text + st.st_size * (i + 1) / nChunks ;
+    if ( p < chunk[i].start ) p = chunk[i].start ;
+    while ( (p < text + st.st_size) && (p[-1] != '\n') ) p++ ;
+    chunk[i].end = p ;
+    chunk[i].limit = limit ;
+    chunk[i].direct = (nChunks == 1) ;
+  }
+  for (i = 1 ; i < nChunks ; i++)
+    if ( pthread_create(&thread[i], NULL, parseChunk, &chunk[i]) != 0 )
+      parseChunk(&chunk[i]), thread[i] = 0 ;
+  parseChunk(&chunk[0]) ;
+  for (i = 1 ; i < nChunks ; i++)
+    if ( thread[i] != 0 ) pthread_join(thread[i], NULL) ;
+  munmap(text, st.st_size) ;
+  for (i = 0, ok = TRUE ; i < nChunks ; i++) ok = ok && chunk[i].ok ;
+  /* in file order, so a later line for a location wins */
+  for (i = 0 ; ok && (i < nChunks) ; i++)
+  { for (j = 0 ; j < chunk[i].n ; j++)
+      iMem[chunk[i].locs[j]] = chunk[i].ins[j] ;
+    if ( chunk[i].top > *top ) *top = chunk[i].top ;
+  }
+  for (i = 0 ; i < nChunks ; i++)
+  { free(chunk[i].locs) ;
+    free(chunk[i].ins) ;
+  }
+  return ok ;
+#else
+  return FALSE ;
+#endif
+} /* fastLoad */
+
+/********************************************/
+int readInstructions (void)
+{ OPCODE op;
+  int arg1, arg3;
+  NUM arg2;
+  int loc, lineNo, limit, top;
+  clearMachine () ;
+  /* all-zero slots read as HALT 0,0,0 */
+  limit = (iaddrSize > 0) ? iaddrSize : IADDR_MAX ;
+  if ( iMem == NULL )
+  { iMem = (INSTRUCTION *) mapZero((size_t) limit * sizeof(INSTRUCTION)) ;
+    iMemSize = limit ;
+  }
+  else clearZero(iMem, (size_t) limit * sizeof(INSTRUCTION)) ;
+  top = IADDR_SIZE ;
+  lineNo = 0 ;
+  if ( fastLoad(limit, &top) )
+  { if ( iaddrSize == 0 ) iaddrSize = top ;
+    return TRUE ;
+  }
+  while (! feof(pgm))
+  { fgets( in_Line, LINESIZE-2, pgm  ) ;
+    inCol = 0 ; 
+    lineNo++;
+    lineLen = strlen(in_Line)-1 ;
+    if (in_Line[lineLen]=='\n') in_Line[lineLen] = '\0' ;
+    else in_Line[++lineLen] = '\0';
+    if ( (nonBlank()) && (in_Line[inCol] != '*') )
+    { if (! getNum())
+        return error("Bad location", lineNo,-1);
+      loc = num;
+      if ((loc < 0) || (loc >= limit))
+        return error("Location too large",lineNo,loc);
+      if (loc >= top) top = loc + 1 ;
+      if (! skipCh(':'))
+        return error("Missing colon", lineNo,loc);
+      if (! getWord ())
+        return error("Missing opcode", lineNo,loc);
+      op = opHALT ;
+      while ((op < opRALim)
+             && (strncmp(opCodeTab[op], word, 4) != 0) )
+          op = (OPCODE)((int)op + 1) ;
+      if (strncmp(opCodeTab[op], word, 4) != 0)
+          return error("Illegal opcode", lineNo,loc);
+      switch ( opClass(op) )
+      { case opclRR :
+        /***********************************/
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad first register", lineNo,loc);
+        arg1 = num;
+        if ( ! skipCh(','))
+            return error("Missing comma", lineNo, loc);
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad second register", lineNo, loc);
+        arg2 = _num;
+        if ( ! skipCh(',')) 
+            return error("Missing comma", lineNo,loc);
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad third register", lineNo,loc);
+        arg3 = num;
+        break;
+
+        case opclRM :
+        case opclRA :
+        /***********************************/
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
+            return error("Bad first register", lineNo,loc);
+        arg1 = num;
+        if ( ! skipCh(','))
+            return error("Missing comma", lineNo,loc);
+        if (! getNum ())
+            return error("Bad displacement", lineNo,loc);
+        arg2 = _num;
+        if ( ! skipCh('(') && ! skipCh(',') )
+            return error("Missing LParen", lineNo,loc);
+        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS))
+            return error("Bad second register", lineNo,loc);
+        arg3 = num;
+        break;
+        }
+      iMem[loc].iop = op;
+      iMem[loc].iarg1 = arg1;
+      iMem[loc].iarg2 = arg2;
+      iMem[loc].iarg3 = arg3;
+    }
+  }
+  if ( iaddrSize == 0 ) iaddrSize = top ;
+  return TRUE;
+} /* readInstructions */
+
+/********************************************/
+/* Function writesReg returns the register  */
+/* the instruction at loc writes, other     */
+/* than the pc, or -1                       */
+/********************************************/
+int writesReg ( int loc )
+{ INSTRUCTION * ip = &iMem[loc] ;
+  if ( (ip->iop == opHALT) || (ip->iop == opOUT) || (ip->iop == opST)
+       || (ip->iop >= opJLT) || (ip->iarg1 == PC_REG) )
+    return -1 ;
+  return ip->iarg1 ;
+} /* writesReg */
+
+/********************************************/
+/* Function writeRange sets *v to the range */
+/* of the value written by the instruction  */
+/* at loc                                   */
+/********************************************/
+void writeRange ( int loc, RANGE * v )
+{ INSTRUCTION * ip = &iMem[loc] ;
+  long k = ip->iarg2.attr.valint, lo, hi ;
+  int s = ip->iarg3 ;
+  v->known = FALSE ;
+  if ( (ip->iop != opLDC) && (ip->iop != opLDA) && (ip->iop != opADDI)
+       && (ip->iop != opMULI) ) return ;
+  if ( ip->iarg2.type != INT ) return ;
+  if ( ip->iop == opLDC ) lo = hi = k ;
+  else if ( s == PC_REG ) lo = hi = loc + 1 ;
+  else if ( ! regRange[s].known ) return ;
+  else
+  { lo = regRange[s].lo ;
+    hi = regRange[s].hi ;
+  }
+  if ( ip->iop == opMULI )
+  { lo *= k ;
+    hi *= k ;
+    if ( k < 0 ) { long x = lo ; lo = hi ; hi = x ; }
+  }
+  else if ( ip->iop != opLDC )
+  { lo += k ;
+    hi += k ;
+  }
+  if ( (lo < -(1L << 30)) || (hi > (1L << 30)) ) return ;
+  v->known = TRUE ;
+  v->lo = (int) lo ;
+  v->hi = (int) hi ;
+} /* writeRange */
+
+/********************************************/
+/* Procedure verifyInstructions bounds each */
+/* register over all runs: it starts at 0,  */
+/* as clearMachine leaves it, and takes the */
+/* union of every value the program can     */
+/* write to it. Only LDC, LDA, ADDI and     */
+/* MULI give known values; anything else,   */
+/* and a range still growing after          */
+/* WIDEN_PASSES passes, makes the register  */
+/* unknown. An LD or ST whose base has a    */
+/* known range that keeps the address       */
+/* inside dMem is proven                    */
+/********************************************/
+void verifyInstructions (void)
+{ int loc, r, pass, changed ;
+  RANGE v ;
+  INSTRUCTION * ip ;
+  for (r = 0 ; r < NO_REGS ; r++)
+  { regRange[r].known = (r != PC_REG) ;
+    regRange[r].lo = regRange[r].hi = 0 ;
+  }
+  pass = 0 ;
+  do
+  { changed = FALSE ;
+    pass++ ;
+    for (loc = 0 ; loc < iaddrSize ; loc++)
+    { r = writesReg(loc) ;
+      if ( (r < 0) || ! regRange[r].known ) continue;
+      writeRange(loc, &v) ;
+      if ( v.known && (v.lo >= regRange[r].lo) && (v.hi <= regRange[r].hi) )
+        continue;
+      changed = TRUE ;
+      if ( ! v.known || (pass > WIDEN_PASSES) ) regRange[r].known = FALSE ;
+      else
+      { if ( v.lo < regRange[r].lo ) regRange[r].lo = v.lo ;
+        if ( v.hi > regRange[r].hi ) regRange[r].hi = v.hi ;
+      }
+    }
+  }
+  while (changed) ;
+
+  if ( addrProven == NULL ) addrProven = (char *) mapZero(iaddrSize) ;
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+  { ip = &iMem[loc] ;
+    r = ip->iarg3 ;
+    addrProven[loc] = ( ((ip->iop == opLD) || (ip->iop == opST))
+                        && (ip->iarg2.type == INT) && (r != PC_REG)
+                        && regRange[r].known
+                        && (ip->iarg2.attr.valint + regRange[r].lo >= 0)
+                        && (ip->iarg2.attr.valint + regRange[r].hi < daddrSize) ) ;
+  }
+} /* verifyInstructions */
+
+/********************************************/
+int constReg ( int r, int * c )
+{ if ( ! regRange[r].known || (regRange[r].lo != regRange[r].hi) )
+    return FALSE ;
+  *c = regRange[r].lo ;
+  return TRUE ;
+} /* constReg */
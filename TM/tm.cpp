@@ -9,367 +9,624 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
-
-#ifndef TRUE
-#define TRUE 1
+#include <stddef.h>
+#include <time.h>
+#include "tm.h"
+#if defined(__unix__)
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
 #endif
-#ifndef FALSE
-#define FALSE 0
+#if defined(__linux__) && defined(__LP64__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#include <signal.h>
+#include <ucontext.h>
 #endif
-
-/******* const *******/
-#define   IADDR_SIZE  1024 /* increase for large programs */
-#define   DADDR_SIZE  1024 /* increase for large programs */
-#define   NO_REGS 8
-#define   PC_REG  7
-
-#define   LINESIZE  121
-#define   WORDSIZE  20
 
 /******* type  *******/
 
+/* opcodes of the decoded instruction stream: each TM
+ * instruction is specialized on its operands at load
+ * time; dopSLOW falls back to stepTM for the rare
+ * forms (pc as an operand, float displacements)
+ */
 typedef enum {
-   opclRR,     /* reg operands r,s,t */
-   opclRM,     /* reg r, mem d+s */
-   opclRA      /* reg r, int d+s */
-   } OPCLASS;
+   dopSLOW,   /* execute with stepTM */
+   dopIMEM,   /* sentinel past the end of iMem */
+   dopDMEM,   /* constant data address out of range */
+   dopHALT, dopIN, dopOUT,
+   dopADD, dopSUB, dopXOR, dopMUL, dopDIV,
+   dopLD,     /* reg(r) = mem(k+reg(s)) */
+   dopST,     /* mem(k+reg(s)) = reg(r) */
+   dopLDK,    /* reg(r) = mem(k) */
+   dopSTK,    /* mem(k) = reg(r) */
+   dopLDU,    /* dopLD with the address proven, unchecked */
+   dopSTU,    /* dopST with the address proven, unchecked */
+   dopLDPC,   /* reg(7) = mem(k+reg(s)) */
+   dopLDA,    /* reg(r) = k+reg(s), int displacement */
+   dopLDCI,   /* reg(r) = k, int */
+   dopLDCF,   /* reg(r) = k, float */
+   dopMULI,   /* reg(r) = reg(s)*k, int */
+   dopJMP,    /* reg(7) = k */
+   dopJMPR,   /* reg(7) = k+reg(s) */
+   dopJLT, dopJLE, dopJGT, dopJGE, dopJEQ, dopJNE,       /* to k */
+   dopJLTR, dopJLER, dopJGTR, dopJGER, dopJEQR, dopJNER, /* to k+reg(s) */
+   /* superinstructions for cgen idioms; the slots they
+    * cover keep their own decoding for jumps into them
+    */
+   dopCMPLT, dopCMPLE, dopCMPGT, dopCMPGE, dopCMPEQ, dopCMPNE,
+              /* SUB r,s,t; Jxx r,2(pc); LDC r,0; LDA pc,1(pc); LDC r,1 */
+   dopPUSHLD, /* ST r,k(s); LD x,d(y); LD t,k(s) */
+   dopPUSHLDC,/* ST r,k(s); LDC x,d; LD t,k(s) */
+   dopLIM
+   } DOPCODE;
 
-typedef enum {
-   /* RR instructions */
-   opHALT,    /* RR     halt, operands are ignored */
-   opIN,      /* RR     read into reg(r); s and t are ignored */
-   opOUT,     /* RR     write from reg(r), s and t are ignored */
-   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
-   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
-   opXOR,    /* RR     reg(r) = reg(s)^reg(t)*/
-   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
-   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
-   opRRLim,   /* limit of RR opcodes */
-
-   /* RM instructions */
-   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
-   opST,      /* RM     mem(d+reg(s)) = reg(r) */
-   opRMLim,   /* Limit of RM opcodes */
-
-   /* RA instructions */
-   opLDA,     /* RA     reg(r) = d+reg(s) */
-   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
-   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
-   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
-   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
-   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
-   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
-   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
-   opRALim    /* Limit of RA opcodes */
-   } OPCODE;
-
-typedef enum {
-   srOKAY,
-   srHALT,
-   srIMEM_ERR,
-   srDMEM_ERR,
-   srZERODIVIDE,
-   srTYPE_ERR,
-   srMEM_FLOAT
-   } STEPRESULT;
-
-typedef enum{INT,FLOAT} NumType;
-typedef struct {union {int valint; float valfloat;} attr; NumType type;} NUM;
+typedef struct {
+      void * handler ;   /* threaded code address, set by runTM */
+      short dop ;
+      unsigned char r, s, t ;
+      union {int valint; float valfloat;} k ;
+   } DINSTRUCTION;
 
+/* a basic block: straight-line code entered only
+ * at start and left only after its last instruction
+ */
 typedef struct {
-      int iop  ;
-      int iarg1  ;
-      NUM iarg2  ;
-      int iarg3  ;
-   } INSTRUCTION;
+      int start ;   /* first iMem location */
+      int len ;     /* number of instructions */
+   } BLOCK;
 
+/* the decoding of a program, kept for the contexts
+ * sharing it once its own context decoded again
+ */
+typedef struct {
+      DINSTRUCTION * dCode ;
+      char * addrProven, * leader ;
+      BLOCK * blocks ;
+      int * blockOf ;
+   } DECODING;
 /******** vars ********/
-int iloc = 0 ;
-int dloc = 0 ;
 int traceflag = FALSE;
-int icountflag = FALSE;
 
-INSTRUCTION iMem [IADDR_SIZE];
-NUM dMem [DADDR_SIZE];
-NUM reg [NO_REGS];
+/* debugging state of the command loop */
+char * breakAt = NULL ;   /* iaddrSize+1 flags: stop before executing */
+int nBreaks = 0 ;
+char * watchAt = NULL ;   /* daddrSize flags: stop after a store */
+int nWatches = 0 ;
+int watchHit ;            /* location whose store stopped the run */
+TMLOCAL int storedAt = -1 ;  /* location of the last ST done by stepTM */
+TMLOCAL int loadedAt = -1 ;  /* location of the last LD done by stepTM */
+TMLOCAL long runLimit = 0 ;  /* stop after this many instructions, or 0 */
 
-char * opCodeTab[]
-        = {"HALT","IN","OUT","ADD","SUB","XOR","MUL","DIV","????",
-            /* RR opcodes */
-           "LD","ST","????", /* RM opcodes */
-           "LDA","LDC","JLT","JLE","JGT","JGE","JEQ","JNE","????"
-           /* RA opcodes */
-          };
+/* input of a batch run (--run and the like): read from standard
+ * input with no prompts, mapped or in large blocks, or from
+ * text given to this thread with openText
+ */
+#define INBUF_SIZE  (1 << 16)
+#define INTOKEN     64     /* longest value, as read ahead */
+TMLOCAL int batchInput = FALSE ;
+TMLOCAL int inputEnded = FALSE ;   /* an IN found no more input */
+char inBuf [INBUF_SIZE] ;
+TMLOCAL char * inNext = inBuf ;    /* unread input ... */
+TMLOCAL char * inEnd = inBuf ;     /* ... up to here */
+TMLOCAL int inAll = FALSE ;        /* nothing left to read past inEnd */
 
-char * stepResultTab[]
-        = {"OK","Halted","Instruction Memory Fault",
-           "Data Memory Fault","Division by 0","Type Error","Memory FLoat"
-          };
+/* IN and OUT of the bound machine, when it has hooks */
+TMLOCAL TMINHOOK inHook = NULL ;
+TMLOCAL void * inUser = NULL ;
+TMLOCAL TMOUTHOOK outHook = NULL ;
+TMLOCAL void * outUser = NULL ;
 
-char pgmName[20];
-FILE *pgm  ;
+/* output of a batch run: OUT values are formatted into outBuf,
+ * which is written out when full, at HALT and at the end of
+ * the run
+ */
+#define OUTBUF_SIZE  (1 << 16)
+int batchOutput = FALSE ;
+OUTFORMAT outFormat = outTEXT ;
+char outBuf [OUTBUF_SIZE] ;
+int outLen = 0 ;
+TMLOCAL FILE * msgOut = NULL ;  /* HALT and the result of a run; stderr
+                                 * when stdout has binary output, NULL
+                                 * for none */
 
-char in_Line[LINESIZE] ;
-int lineLen ;
-int inCol  ;
-int num  ;
-NUM _num  ;
-char word[WORDSIZE] ;
-char ch  ;
-int done  ;
+/* profile of a --profile run, by iMem and by dMem location */
+long * profCount = NULL ;   /* executions of each slot */
+long * profTaken = NULL ;   /* times control did not go on to the next slot */
+long * profBack = NULL ;    /* of those, jumps back to the slot or before */
+int * profBackTo = NULL ;   /* target of the last backward jump */
+long * profReads = NULL ;   /* LDs of each dMem location */
+long * profWrites = NULL ;  /* STs of each dMem location */
 
-/********************************************/
-int opClass( int c )
-{ if      ( c <= opRRLim) return ( opclRR );
-  else if ( c <= opRMLim) return ( opclRM );
-  else                    return ( opclRA );
-} /* opClass */
+/* the ring of a --trace run, mapped from the trace file
+ * or, without mmap, written to traceFile at the end
+ */
+TRACEHEADER * traceHead = NULL ;
+TRACERECORD * traceRing = NULL ;
+long traceMask ;            /* records - 1 */
+long traceCount = 0 ;       /* records written */
+FILE * traceFile = NULL ;
+
+TMLOCAL DINSTRUCTION * dCode = NULL;   /* iaddrSize+1 slots */
+TMLOCAL int dCodeThreaded = FALSE;
+TMLOCAL int programShared = FALSE;     /* the program belongs to another context */
+TMLOCAL int decodeShared = FALSE;      /* and its decoding: dCode, addrProven, blocks */
+TMLOCAL int decodeLent = FALSE;        /* other contexts share this one's decoding */
+TMLOCAL DECODING * retired = NULL;     /* the decoding lent, since decoded again */
+
+TMLOCAL BLOCK * blocks = NULL;
+TMLOCAL int nBlocks = 0;
+TMLOCAL int * blockOf = NULL;   /* block holding each location */
+TMLOCAL char * leader = NULL;   /* iaddrSize+1 flags: starts a block */
+
+char pgmName[120];
 
 /********************************************/
 void writeInstruction ( int loc )
 { printf( "%5d: ", loc) ;
-  if ( (loc >= 0) && (loc < IADDR_SIZE) )
-  { printf("%6s%3d,", opCodeTab[iMem[loc].iop], iMem[loc].iarg1);
-    switch ( opClass(iMem[loc].iop) )
-    { case opclRR:
-                   if (iMem[loc].iarg2.type == INT) printf("%1d", iMem[loc].iarg2.attr.valint);
-                   else printf("%.3f", iMem[loc].iarg2.attr.valfloat);
-                   printf(",%1d", iMem[loc].iarg3);
-                   break;
-      case opclRM:
-      case opclRA:
-                   if (iMem[loc].iarg2.type == INT) printf("%3d", iMem[loc].iarg2.attr.valint);
-                   else printf("%.3f", iMem[loc].iarg2.attr.valfloat);
-                   printf("(%1d)", iMem[loc].iarg2, iMem[loc].iarg3);
-                   break;
-    }
+  if ( (loc >= 0) && (loc < iaddrSize) )
+  { printInstruction(stdout, loc) ;
     printf ("\n") ;
   }
 } /* writeInstruction */
 
 /********************************************/
-void getCh (void)
-{ if (++inCol < lineLen)
-  ch = in_Line[inCol] ;
-  else ch = ' ' ;
-} /* getCh */
+/* Function staticTarget stores in *target  */
+/* the jump target of the instruction at    */
+/* loc and returns TRUE when the target is  */
+/* known at load time: relative to the pc   */
+/* or to a register the verifier proved     */
+/* constant                                 */
+/********************************************/
+int staticTarget ( int loc, int * target )
+{ INSTRUCTION * ip = &iMem[loc] ;
+  int base ;
+  if ( (opClass(ip->iop) != opclRA) || (ip->iarg2.type != INT) )
+    return FALSE ;
+  if ( ip->iop == opLDC )
+  { *target = ip->iarg2.attr.valint ;
+    return (ip->iarg1 == PC_REG) ;
+  }
+  if ( ip->iop == opMULI ) return FALSE ;
+  if ( ((ip->iop == opLDA) || (ip->iop == opADDI)) && (ip->iarg1 != PC_REG) )
+    return FALSE ;
+  if ( ip->iarg3 == PC_REG ) base = loc + 1 ;
+  else if ( ! constReg(ip->iarg3, &base) ) return FALSE ;
+  *target = base + ip->iarg2.attr.valint ;
+  return TRUE ;
+} /* staticTarget */
 
 /********************************************/
-int nonBlank (void)
-{ while ((inCol < lineLen)
-         && (in_Line[inCol] == ' ') )
-    inCol++ ;
-  if (inCol < lineLen)
-  { ch = in_Line[inCol] ;
-    return TRUE ; }
-  else
-  { ch = ' ' ;
-    return FALSE ; }
-} /* nonBlank */
+/* Function endsBlock returns TRUE if the   */
+/* instruction at loc can transfer control  */
+/* anywhere but to loc+1                    */
+/********************************************/
+int endsBlock ( int loc )
+{ INSTRUCTION * ip = &iMem[loc] ;
+  if ( (ip->iop == opHALT) || (ip->iop >= opJLT) ) return TRUE ;
+  if ( opClass(ip->iop) == opclRR )
+    return (ip->iop != opOUT) && (ip->iarg1 == PC_REG) ;
+  return (ip->iop != opST) && (ip->iarg1 == PC_REG) ;
+} /* endsBlock */
 
 /********************************************/
-int getNum (void)
-{
-  char sca[25]; int cntsca;
-  int temp = FALSE;
-  float tmp;
-  _num.attr.valfloat = 0 ; _num.type = INT;
-  do
-  {
-    cntsca = 0; tmp = 0;
-    while ( nonBlank() && ((ch == '+') || (ch == '-')) )
-    { temp = FALSE ;
-      if (ch == '-')  sca[cntsca++] = ch ;
-      getCh();
-    }
-    nonBlank();
-    while (isdigit(ch) || (ch == '.' || ch == 'E' || ch == 'e'))
-    { temp = TRUE ;
-      sca[cntsca++] = ch ;
-      getCh();
-    }
-    sca[cntsca] = '\0';
-    sscanf(sca, "%f", &tmp) ;
-    _num.attr.valfloat += tmp;
-  } while ( (nonBlank()) && ((ch == '+') || (ch == '-')) ) ;
-  _num.type = FLOAT;
-  if (_num.attr.valfloat == (int)_num.attr.valfloat)
-  {
-    _num.attr.valint = (int)_num.attr.valfloat;
-    _num.type = INT;
-    num = _num.attr.valint;
-  }
-  return temp;
-} 
-/*
-int getNum (void)
-{ int sign;
-  int term;
-  int temp = FALSE;
-  num = 0;
-  do
-  { sign = 1;
-    while ( nonBlank() && ((ch == '+') || (ch == '-')) )
-    { temp = FALSE ;
-      if (ch == '-')  sign = - sign ;
-      getCh();
-    }
-    term = 0 ;
-    nonBlank();
-    while (isdigit(ch))
-    { temp = TRUE ;
-      term = term * 10 + ( ch - '0' ) ;
-      getCh();
-    }
-    num = num + (term * sign) ;
-  } while ( (nonBlank()) && ((ch == '+') || (ch == '-')) ) ;
-  return temp;
-}
-*/
-/********************************************/
-int getWord (void)
-{ int temp = FALSE;
-  int length = 0;
-  if (nonBlank ())
-  { while (isalnum(ch))
-    { if (length < WORDSIZE-1) word [length++] =  ch ;
-      getCh() ;
-    }
-    word[length] = '\0';
-    temp = (length != 0);
-  }
-  return temp;
-} /* getWord */
-
-/********************************************/
-int skipCh ( char c  )
-{ int temp = FALSE;
-  if ( nonBlank() && (ch == c) )
-  { getCh();
-    temp = TRUE;
-  }
-  return temp;
-} /* skipCh */
-
-/********************************************/
-int atEOL(void)
-{ return ( ! nonBlank ());
-} /* atEOL */
-
-/********************************************/
-int error( char * msg, int lineNo, int instNo)
-{ printf("Line %d",lineNo);
-  if (instNo >= 0) printf(" (Instruction %d)",instNo);
-  printf("   %s\n",msg);
-  return FALSE;
-} /* error */
-
-/********************************************/
-int readInstructions (void)
-{ OPCODE op;
-  int arg1, arg3;
-  NUM arg2;
-  int loc, regNo, lineNo;
-  for (regNo = 0 ; regNo < NO_REGS ; regNo++)
-  {
-      reg[regNo].attr.valfloat = 0 ;
-      reg[regNo].type = INT;
-  }
-  dMem[0].attr.valint = DADDR_SIZE - 1 ; dMem[0].type = INT;
-  for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-  {
-      dMem[loc].attr.valfloat = 0 ;
-      dMem[loc].type = INT;
-  }
-  for (loc = 0 ; loc < IADDR_SIZE ; loc++)
-  { iMem[loc].iop = opHALT ;
-    iMem[loc].iarg1 = 0 ;
-    iMem[loc].iarg2.attr.valint = 0 ;
-    iMem[loc].iarg2.type = INT ;
-    iMem[loc].iarg3 = 0 ;
-  }
-  lineNo = 0 ;
-  while (! feof(pgm))
-  { fgets( in_Line, LINESIZE-2, pgm  ) ;
-    inCol = 0 ; 
-    lineNo++;
-    lineLen = strlen(in_Line)-1 ;
-    if (in_Line[lineLen]=='\n') in_Line[lineLen] = '\0' ;
-    else in_Line[++lineLen] = '\0';
-    if ( (nonBlank()) && (in_Line[inCol] != '*') )
-    { if (! getNum())
-        return error("Bad location", lineNo,-1);
-      loc = num;
-      if (loc > IADDR_SIZE)
-        return error("Location too large",lineNo,loc);
-      if (! skipCh(':'))
-        return error("Missing colon", lineNo,loc);
-      if (! getWord ())
-        return error("Missing opcode", lineNo,loc);
-      op = opHALT ;
-      while ((op < opRALim)
-             && (strncmp(opCodeTab[op], word, 4) != 0) )
-          op = (OPCODE)((int)op + 1) ;
-      if (strncmp(opCodeTab[op], word, 4) != 0)
-          return error("Illegal opcode", lineNo,loc);
-      switch ( opClass(op) )
-      { case opclRR :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo, loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad second register", lineNo, loc);
-        arg2 = _num;
-        if ( ! skipCh(',')) 
-            return error("Missing comma", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad third register", lineNo,loc);
-        arg3 = num;
+/* Procedure buildBlocks splits iMem into   */
+/* basic blocks. Leaders are location 0,    */
+/* static jump targets and the successors   */
+/* of instructions that end a block         */
+/********************************************/
+void buildBlocks (void)
+{ int loc, target ;
+  if ( leader == NULL )
+  { leader = (char *) mapZero(iaddrSize + 1) ;
+    blocks = (BLOCK *) mapZero((size_t) iaddrSize * sizeof(BLOCK)) ;
+    blockOf = (int *) mapZero((size_t) iaddrSize * sizeof(int)) ;
+  }
+  else clearZero(leader, iaddrSize + 1) ;
+  leader[0] = TRUE ;
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+  { if ( endsBlock(loc) ) leader[loc+1] = TRUE ;
+    if ( staticTarget(loc, &target) && (target >= 0) && (target < iaddrSize) )
+      leader[target] = TRUE ;
+  }
+  nBlocks = 0 ;
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+  { if ( leader[loc] )
+    { blocks[nBlocks].start = loc ;
+      blocks[nBlocks].len = 0 ;
+      nBlocks++ ;
+    }
+    blocks[nBlocks-1].len++ ;
+    blockOf[loc] = nBlocks - 1 ;
+  }
+} /* buildBlocks */
+
+/********************************************/
+/* Function isLeader returns TRUE if loc is */
+/* a valid location that starts a block     */
+/********************************************/
+int isLeader ( int loc )
+{ return (loc >= 0) && (loc < iaddrSize)
+         && (blocks[blockOf[loc]].start == loc) ;
+} /* isLeader */
+
+/********************************************/
+/* Procedure decodeInstructions translates  */
+/* iMem into dCode for runTM. Reads of the  */
+/* pc or of a register the verifier proved  */
+/* constant as a base are folded into       */
+/* constants, and LD/ST with a proven       */
+/* address become unchecked. Static jumps   */
+/* are specialized only when their target   */
+/* is a block leader, so runTM takes them   */
+/* without a bounds check                   */
+/********************************************/
+void decodeInstructions (void)
+{ int loc, r, s, t, k, c, known;
+  INSTRUCTION * ip;
+  DINSTRUCTION * dp;
+  if ( dCode == NULL )
+    dCode = (DINSTRUCTION *) mapZero((size_t) (iaddrSize + 1) * sizeof(DINSTRUCTION)) ;
+  buildBlocks () ;
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+  { ip = &iMem[loc] ;
+    dp = &dCode[loc] ;
+    r = ip->iarg1 ;
+    s = t = ip->iarg3 ;
+    k = ip->iarg2.attr.valint ;
+    known = (s == PC_REG) ;
+    c = loc + 1 ;
+    if ( ! known ) known = constReg(s, &c) ;
+    dp->dop = dopSLOW ;
+    dp->r = r ; dp->s = s ; dp->t = t ;
+    dp->k.valint = k ;
+    switch ( opClass(ip->iop) )
+    { case opclRR :
+        s = ip->iarg2.attr.valint ;
+        dp->s = s ;
+        if (ip->iop == opHALT) dp->dop = dopHALT ;
+        else if ( (ip->iarg2.type != INT) || (s < 0) || (s >= NO_REGS)
+                  || (r == PC_REG) || (s == PC_REG) || (t == PC_REG) ) ;
+        else switch (ip->iop)
+        { case opIN :  dp->dop = dopIN ;  break;
+          case opOUT : dp->dop = dopOUT ; break;
+          case opADD : dp->dop = dopADD ; break;
+          case opSUB : dp->dop = dopSUB ; break;
+          case opXOR : dp->dop = dopXOR ; break;
+          case opMUL : dp->dop = dopMUL ; break;
+          case opDIV : dp->dop = dopDIV ; break;
+          default : break;
+        }
+        break;
+
+      case opclRM :
+        if (ip->iarg2.type != INT) break;
+        if (known)
+        { k += c ;
+          dp->k.valint = k ;
+          if (r == PC_REG) ;
+          else if ( (k < 0) || (k >= daddrSize) ) dp->dop = dopDMEM ;
+          else dp->dop = (ip->iop == opLD) ? dopLDK : dopSTK ;
+        }
+        else if (ip->iop == opLD)
+          dp->dop = (r == PC_REG) ? dopLDPC : addrProven[loc] ? dopLDU : dopLD ;
+        else if (r != PC_REG) dp->dop = addrProven[loc] ? dopSTU : dopST ;
         break;
 
-        case opclRM :
-        case opclRA :
-        /***********************************/
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS) )
-            return error("Bad first register", lineNo,loc);
-        arg1 = num;
-        if ( ! skipCh(','))
-            return error("Missing comma", lineNo,loc);
-        if (! getNum ())
-            return error("Bad displacement", lineNo,loc);
-        arg2 = _num;
-        if ( ! skipCh('(') && ! skipCh(',') )
-            return error("Missing LParen", lineNo,loc);
-        if ( (! getNum ()) || (num < 0) || (num >= NO_REGS))
-            return error("Bad second register", lineNo,loc);
-        arg3 = num;
+      case opclRA :
+        if (ip->iop == opLDC)
+        { if (r == PC_REG)
+          { if (ip->iarg2.type == INT) dp->dop = dopJMP ; }
+          else dp->dop = (ip->iarg2.type == INT) ? dopLDCI : dopLDCF ;
+          break;
+        }
+        if (ip->iarg2.type != INT) break;
+        if (ip->iop == opMULI)
+        { if (r == PC_REG) ;
+          else if (known)
+          { dp->k.valint = k * c ;
+            dp->dop = dopLDCI ;
+          }
+          else dp->dop = dopMULI ;
+          break;
+        }
+        if (known)
+        { k += c ;
+          dp->k.valint = k ;
+        }
+        if ((ip->iop == opLDA) || (ip->iop == opADDI))
+        { if (r == PC_REG) dp->dop = known ? dopJMP : dopJMPR ;
+          else dp->dop = known ? dopLDCI : dopLDA ;
+        }
+        else if (r != PC_REG)
+          dp->dop = ( known ? dopJLT : dopJLTR ) + (ip->iop - opJLT) ;
         break;
+    }
+    if ( ((dp->dop == dopJMP) || ((dp->dop >= dopJLT) && (dp->dop <= dopJNE)))
+         && ! isLeader(dp->k.valint) )
+      dp->dop = dopSLOW ;
+  }
+  dCode[iaddrSize].dop = dopIMEM ;
+  dCodeThreaded = FALSE ;
+} /* decodeInstructions */
+
+/********************************************/
+/* Procedure fuseInstructions replaces the  */
+/* first slot of the compare and operand    */
+/* push/pop sequences emitted by genExp     */
+/* with superinstructions                   */
+/********************************************/
+void fuseInstructions (void)
+{ int loc, r ;
+  DINSTRUCTION * dp ;
+  for (loc = 0 ; loc + 4 < iaddrSize ; loc++)
+  { dp = &dCode[loc] ;
+    r = dp->r ;
+    if ( (dp->dop == dopSUB)
+         && (dp[1].dop >= dopJLT) && (dp[1].dop <= dopJNE)
+         && (dp[1].r == r) && (dp[1].k.valint == loc + 4)
+         && (dp[2].dop == dopLDCI) && (dp[2].r == r) && (dp[2].k.valint == 0)
+         && (dp[3].dop == dopJMP) && (dp[3].k.valint == loc + 5)
+         && (dp[4].dop == dopLDCI) && (dp[4].r == r) && (dp[4].k.valint == 1) )
+      dp->dop = dopCMPLT + (dp[1].dop - dopJLT) ;
+    else if ( (dp->dop == dopST) && (dp[2].dop == dopLD)
+         && (dp[2].s == dp->s) && (dp[2].k.valint == dp->k.valint)
+         && (dp[1].r != dp->s) )
+    { if ( (dp[1].dop == dopLD) || (dp[1].dop == dopLDK) )
+        dp->dop = dopPUSHLD ;
+      else if ( (dp[1].dop == dopLDCI) || (dp[1].dop == dopLDCF) )
+        dp->dop = dopPUSHLDC ;
+    }
+  }
+} /* fuseInstructions */
+
+
+/********************************************/
+/* Procedure flushOut writes the buffered   */
+/* output of a batch run                    */
+/********************************************/
+void flushOut (void)
+{ if ( outLen > 0 )
+  { fwrite(outBuf, 1, outLen, stdout) ;
+    outLen = 0 ;
+  }
+} /* flushOut */
+
+/********************************************/
+/* Procedure openInput sets up the input of */
+/* a batch run: standard input is mapped    */
+/* when it is a file, and otherwise read    */
+/* INBUF_SIZE bytes at a time               */
+/********************************************/
+void openInput (void)
+{ batchInput = TRUE ;
+#if defined(__linux__) && defined(__LP64__)
+  struct stat st ;
+  void * p ;
+  if ( (fstat(0, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0) )
+  { p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, 0, 0) ;
+    if ( p != MAP_FAILED )
+    { madvise(p, st.st_size, MADV_SEQUENTIAL) ;
+      inNext = (char *) p ;
+      inEnd = inNext + st.st_size ;
+      inAll = TRUE ;
+    }
+  }
+#endif
+} /* openInput */
+
+/********************************************/
+void openText ( char * text, size_t len )
+{ batchInput = TRUE ;
+  inNext = text ;
+  inEnd = text + len ;
+  inAll = TRUE ;
+} /* openText */
+
+/* Procedure fillInput reads more input when fewer
+ * than INTOKEN bytes are left unread
+ */
+void fillInput (void)
+{ size_t left = inEnd - inNext, got ;
+  if ( inAll || (left >= INTOKEN) ) return ;
+  memmove(inBuf, inNext, left) ;
+  got = fread(inBuf + left, 1, INBUF_SIZE - left, stdin) ;
+  inNext = inBuf ;
+  inEnd = inBuf + left + got ;
+  if ( got == 0 ) inAll = TRUE ;
+} /* fillInput */
+
+/********************************************/
+/* Function readBatch reads the next value  */
+/* of a batch run into *v: an int or a      */
+/* float, signed, separated by white space; */
+/* a float with an int value reads as the   */
+/* int, as with getNum. Anything else is    */
+/* reported and skipped. FALSE at the end   */
+/* of the input                             */
+/********************************************/
+int readBatch ( NUM * v )
+{ char tok[INTOKEN], * p, * end ;
+  unsigned u ;
+  int neg, digits, len ;
+  for (;;)
+  { do
+    { while ( (inNext < inEnd) && isspace((unsigned char) *inNext) ) inNext++ ;
+      fillInput () ;
+    }
+    while ( (inNext < inEnd) && isspace((unsigned char) *inNext) ) ;
+    if ( inNext == inEnd ) return FALSE ;
+    p = inNext ;
+    neg = FALSE ;
+    while ( (p < inEnd) && ((*p == '+') || (*p == '-')) )
+    { if ( *p == '-' ) neg = ! neg ;
+      p++ ;
+    }
+    for (u = 0, digits = 0 ; (p < inEnd) && isdigit((unsigned char) *p) ; p++, digits++)
+      u = u * 10 + (*p - '0') ;
+    if ( (digits > 0) && ((p == inEnd) || isspace((unsigned char) *p)) )
+    { v->attr.valint = (int) (neg ? 0u - u : u) ;
+      v->type = INT ;
+      inNext = p ;
+      return TRUE ;
+    }
+    /* the rest of the token, which may still be a float */
+    for (p = inNext ; (p < inEnd) && ((*p == '+') || (*p == '-')) ; p++) ;
+    for (len = 0 ; (p + len < inEnd) && (len < INTOKEN - 1)
+                   && (isdigit((unsigned char) p[len]) || (p[len] == '.')
+                       || (p[len] == 'e') || (p[len] == 'E')
+                       || ((len > 0) && ((p[len] == '+') || (p[len] == '-'))
+                           && ((p[len-1] == 'e') || (p[len-1] == 'E')))) ; len++)
+      tok[len] = p[len] ;
+    tok[len] = '\0' ;
+    if ( (len > 0) && ((p + len == inEnd) || isspace((unsigned char) p[len])) )
+    { v->attr.valfloat = strtof(tok, &end) ;
+      if ( (end == tok + len) && (digits > 0 || strpbrk(tok, "0123456789")) )
+      { if ( neg ) v->attr.valfloat = - v->attr.valfloat ;
+        v->type = FLOAT ;
+        if ( v->attr.valfloat == (int) v->attr.valfloat )
+        { v->attr.valint = (int) v->attr.valfloat ;
+          v->type = INT ;
         }
-      iMem[loc].iop = op;
-      iMem[loc].iarg1 = arg1;
-      iMem[loc].iarg2 = arg2;
-      iMem[loc].iarg3 = arg3;
+        inNext = p + len ;
+        return TRUE ;
+      }
+    }
+    flushOut () ;
+    if ( msgOut != NULL ) fprintf(msgOut, "Illegal value\n") ;
+    do
+    { while ( (inNext < inEnd) && ! isspace((unsigned char) *inNext) ) inNext++ ;
+      fillInput () ;
     }
+    while ( (inNext < inEnd) && ! isspace((unsigned char) *inNext) ) ;
   }
-  return TRUE;
-} /* readInstructions */
+} /* readBatch */
 
+/********************************************/
+/* Function readIn reads the value of an IN */
+/* instruction from the input hook, if any, */
+/* or else prompting for it unless in a     */
+/* batch run; FALSE, with inputEnded set,   */
+/* at the end of the input                  */
+/********************************************/
+int readIn ( NUM * v )
+{ int ok ;
+  if ( (inHook != NULL) || batchInput )
+  { ok = (inHook != NULL) ? inHook(inUser, v) : readBatch(v) ;
+    if ( ! ok ) inputEnded = TRUE ;
+    return ok ;
+  }
+  do
+  { printf("Enter value for IN instruction: ") ;
+    fflush (stdout);
+    if ( ! getLine() )
+    { printf("\n") ;
+      inputEnded = TRUE ;
+      return FALSE ;
+    }
+    inCol = 0;
+    ok = getNum();
+    if ( ! ok ) printf ("Illegal value\n");
+    else *v = _num;
+  }
+  while (! ok);
+  return TRUE ;
+} /* readIn */
+
+/* Function formatInt writes i at p, returning its end */
+char * formatInt ( char * p, int i )
+{ char d[12] ;
+  int n = 0 ;
+  unsigned u = (i < 0) ? 0u - (unsigned) i : (unsigned) i ;
+  if ( i < 0 ) *p++ = '-' ;
+  do
+  { d[n++] = (char) ('0' + u % 10) ;
+    u /= 10 ;
+  }
+  while ( u != 0 ) ;
+  while ( n > 0 ) *p++ = d[--n] ;
+  return p ;
+} /* formatInt */
 
+/********************************************/
+/* Function formatFloat writes f at p with  */
+/* the fewest significant digits that read  */
+/* back as f, and so that it reads as a     */
+/* float, returning its end                 */
+/********************************************/
+char * formatFloat ( char * p, float f )
+{ int lo = 1, hi = 9, mid, len ;
+  if ( f != f ) return p + sprintf(p, "nan") ;
+  while ( lo < hi )
+  { mid = (lo + hi) / 2 ;
+    sprintf(p, "%.*g", mid, f) ;
+    if ( strtof(p, NULL) == f ) hi = mid ; else lo = mid + 1 ;
+  }
+  len = sprintf(p, "%.*g", lo, f) ;
+  if ( strpbrk(p, ".ei") == NULL )
+  { memcpy(p + len, ".0", 2) ;
+    len += 2 ;
+  }
+  return p + len ;
+} /* formatFloat */
+
+/********************************************/
+char * formatOut ( char * p, NUM v )
+{ if ( outFormat == outBINARY )
+  { memcpy(p, &v.attr, sizeof(v.attr)) ;
+    return p + sizeof(v.attr) ;
+  }
+  if ( outFormat == outTEXT )
+  { memcpy(p, "OUT instruction prints: ", 24) ;
+    p += 24 ;
+  }
+  if ( v.type == INT ) p = formatInt(p, v.attr.valint) ;
+  else if ( outFormat == outTEXT ) p += sprintf(p, "%f", v.attr.valfloat) ;
+  else p = formatFloat(p, v.attr.valfloat) ;
+  *p++ = '\n' ;
+  return p ;
+} /* formatOut */
+
+/********************************************/
+void writeOut ( NUM v )
+{ if ( outHook != NULL )
+  { outHook(outUser, v) ;
+    return ;
+  }
+  if ( batchOutput )
+  { if ( outLen > OUTBUF_SIZE - OUTVALUE ) flushOut () ;
+    outLen = formatOut(outBuf + outLen, v) - outBuf ;
+    return ;
+  }
+  if (v.type == INT)
+    printf ("OUT instruction prints: %d\n", v.attr.valint ) ;
+  else
+    printf ("OUT instruction prints: %f\n", v.attr.valfloat );
+} /* writeOut */
+
+/********************************************/
+/* Function stepTM executes one TM          */
+/* instruction, reading and writing the     */
+/* register planes through getReg and       */
+/* setReg: a, b and d are reg(s), reg(t)    */
+/* and the value for reg(r)                 */
 /********************************************/
 STEPRESULT stepTM (void)
 { INSTRUCTION currentinstruction  ;
   int pc  ;
   int r,t  ;
-  NUM s,m  ;
-  int ok ;
+  NUM s,m,a,b,d  ;
 
-  pc = reg[PC_REG].attr.valint ;
-  if ( (pc < 0) || (pc > IADDR_SIZE)  )
+  pc = regVal[PC_REG].valint ;
+  if ( (pc < 0) || (pc >= iaddrSize)  )
       return srIMEM_ERR ;
-  reg[PC_REG].attr.valint = pc + 1 ; reg[PC_REG].type = INT;
+  regVal[PC_REG].valint = pc + 1 ; regFloat &= ~(1u << PC_REG) ;
   currentinstruction = iMem[ pc ] ;
   switch (opClass(currentinstruction.iop) )
   { case opclRR :
@@ -377,15 +634,18 @@ STEPRESULT stepTM (void)
       r = currentinstruction.iarg1 ;
       s = currentinstruction.iarg2 ;
       t = currentinstruction.iarg3 ;
+      a = getReg(s.attr.valint) ;
+      b = getReg(t) ;
       break;
 
     case opclRM :
     /***********************************/
       r = currentinstruction.iarg1 ;
       s.attr.valint = currentinstruction.iarg3 ; s.type = INT;
-      if (currentinstruction.iarg2.type == INT && reg[s.attr.valint].type == INT)
+      a = getReg(s.attr.valint) ;
+      if (currentinstruction.iarg2.type == INT && a.type == INT)
       {
-        m.attr.valint = currentinstruction.iarg2.attr.valint + reg[s.attr.valint].attr.valint ;
+        m.attr.valint = currentinstruction.iarg2.attr.valint + a.attr.valint ;
         m.type = INT;
       }
       else
@@ -393,15 +653,15 @@ STEPRESULT stepTM (void)
         if (currentinstruction.iarg2.type == FLOAT)
           m.attr.valfloat = currentinstruction.iarg2.attr.valfloat ;
         else m.attr.valfloat = currentinstruction.iarg2.attr.valint ;
-        if (reg[s.attr.valint].type == FLOAT)
-          reg[s.attr.valint].attr.valfloat += reg[s.attr.valint].attr.valfloat;
-        else reg[s.attr.valint].attr.valfloat += reg[s.attr.valint].attr.valint;
+        if (a.type == FLOAT)
+          m.attr.valfloat += a.attr.valfloat;
+        else m.attr.valfloat += a.attr.valint;
 
         m.type = FLOAT;
       }
       if (m.type == FLOAT)
          return srMEM_FLOAT;
-      if ((m.attr.valint < 0) || (m.attr.valint > DADDR_SIZE))
+      if ((m.attr.valint < 0) || (m.attr.valint >= daddrSize))
          return srDMEM_ERR ;
       break;
 
@@ -409,9 +669,10 @@ STEPRESULT stepTM (void)
     /***********************************/
       r = currentinstruction.iarg1 ;
       s.attr.valint = currentinstruction.iarg3 ; s.type = INT;
-      if (currentinstruction.iarg2.type == INT && reg[s.attr.valint].type == INT)
+      a = getReg(s.attr.valint) ;
+      if (currentinstruction.iarg2.type == INT && a.type == INT)
       {
-        m.attr.valint = currentinstruction.iarg2.attr.valint + reg[s.attr.valint].attr.valint ;
+        m.attr.valint = currentinstruction.iarg2.attr.valint + a.attr.valint ;
         m.type = INT;
       }
       else
@@ -419,9 +680,9 @@ STEPRESULT stepTM (void)
         if (currentinstruction.iarg2.type == FLOAT)
           m.attr.valfloat = currentinstruction.iarg2.attr.valfloat ;
         else m.attr.valfloat = currentinstruction.iarg2.attr.valint ;
-        if (reg[s.attr.valint].type == FLOAT)
-          reg[s.attr.valint].attr.valfloat += reg[s.attr.valint].attr.valfloat;
-        else reg[s.attr.valint].attr.valfloat += reg[s.attr.valint].attr.valint;
+        if (a.type == FLOAT)
+          m.attr.valfloat += a.attr.valfloat;
+        else m.attr.valfloat += a.attr.valint;
         
         m.type = FLOAT;
       }
@@ -432,350 +693,2330 @@ STEPRESULT stepTM (void)
   { /* RR instructions */
     case opHALT :
     /***********************************/
-      printf("HALT: %1d,%1d,%1d\n",r,s.attr.valint,t);
+      flushOut () ;
+      if ( msgOut != NULL )
+        fprintf(msgOut, "HALT: %1d,%1d,%1d\n",r,s.attr.valint,t);
       return srHALT ;
       /* break; */
 
     case opIN :
     /***********************************/
-      do
-      { printf("Enter value for IN instruction: ") ;
-        fflush (stdin);
-        fflush (stdout);
-        gets(in_Line);
-        lineLen = strlen(in_Line) ;
-        inCol = 0;
-        ok = getNum();
-        if ( ! ok ) printf ("Illegal value\n");
-        else reg[r] = _num;
+      if ( ! readIn(&d) )
+      { regVal[PC_REG].valint = pc ;   /* to be executed again */
+        return srNO_INPUT ;
       }
-      while (! ok);
+      setReg(r, d) ;
       break;
 
     case opOUT :  
-      if (reg[r].type == INT)
-        printf ("OUT instruction prints: %d\n", reg[r].attr.valint ) ;
-      else
-        printf ("OUT instruction prints: %f\n", reg[r].attr.valfloat );
+      writeOut(getReg(r));
       break;
     case opADD :  
-      if (reg[s.attr.valint].type == INT && reg[t].type == INT)
+      if (a.type == INT && b.type == INT)
       {
-        reg[r].attr.valint = reg[s.attr.valint].attr.valint + reg[t].attr.valint ;
-        reg[r].type = INT;
+        d.attr.valint = a.attr.valint + b.attr.valint ;
+        d.type = INT;
       }
-      else if (reg[s.attr.valint].type == FLOAT && reg[t].type == FLOAT)
+      else if (a.type == FLOAT && b.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat + reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat + b.attr.valfloat ;
+        d.type = FLOAT;
       }
-      else if (reg[s.attr.valint].type == FLOAT)
+      else if (a.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat + reg[t].attr.valint ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat + b.attr.valint ;
+        d.type = FLOAT;
       }
       else
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valint + reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valint + b.attr.valfloat ;
+        d.type = FLOAT;
       }
+      setReg(r, d) ;
       break;
     case opSUB :  
-      if (reg[s.attr.valint].type == INT && reg[t].type == INT)
+      if (a.type == INT && b.type == INT)
       {
-        reg[r].attr.valint = reg[s.attr.valint].attr.valint - reg[t].attr.valint ;
-        reg[r].type = INT;
+        d.attr.valint = a.attr.valint - b.attr.valint ;
+        d.type = INT;
       }
-      else if (reg[s.attr.valint].type == FLOAT && reg[t].type == FLOAT)
+      else if (a.type == FLOAT && b.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat - reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat - b.attr.valfloat ;
+        d.type = FLOAT;
       }
-      else if (reg[s.attr.valint].type == FLOAT)
+      else if (a.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat - reg[t].attr.valint ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat - b.attr.valint ;
+        d.type = FLOAT;
       }
       else
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valint - reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valint - b.attr.valfloat ;
+        d.type = FLOAT;
       }
+      setReg(r, d) ;
       break;
     case opXOR :  
-      if (reg[s.attr.valint].type == INT && reg[t].type == INT)
+      if (a.type == INT && b.type == INT)
       {
-        reg[r].attr.valint = reg[s.attr.valint].attr.valint ^ reg[t].attr.valint ;
-        reg[r].type = INT;
+        d.attr.valint = a.attr.valint ^ b.attr.valint ;
+        d.type = INT;
       }
       else return srTYPE_ERR;
+      setReg(r, d) ;
       break;
     case opMUL :  
-      if (reg[s.attr.valint].type == INT && reg[t].type == INT)
+      if (a.type == INT && b.type == INT)
       {
-        reg[r].attr.valint = reg[s.attr.valint].attr.valint * reg[t].attr.valint ;
-        reg[r].type = INT;
+        d.attr.valint = a.attr.valint * b.attr.valint ;
+        d.type = INT;
       }
-      else if (reg[s.attr.valint].type == FLOAT && reg[t].type == FLOAT)
+      else if (a.type == FLOAT && b.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat * reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat * b.attr.valfloat ;
+        d.type = FLOAT;
       }
-      else if (reg[s.attr.valint].type == FLOAT)
+      else if (a.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat * reg[t].attr.valint ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat * b.attr.valint ;
+        d.type = FLOAT;
       }
       else
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valint * reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valint * b.attr.valfloat ;
+        d.type = FLOAT;
       }
+      setReg(r, d) ;
       break;
 
     case opDIV :
     /***********************************/
-      if ( reg[t].attr.valfloat == 0 ) return srZERODIVIDE ;
+      if ( b.attr.valfloat == 0 ) return srZERODIVIDE ;
 
-      if (reg[s.attr.valint].type == INT && reg[t].type == INT)
+      if (a.type == INT && b.type == INT)
       {
-        reg[r].attr.valint = reg[s.attr.valint].attr.valint / reg[t].attr.valint ;
-        reg[r].type = INT;
+        d.attr.valint = a.attr.valint / b.attr.valint ;
+        d.type = INT;
       }
-      else if (reg[s.attr.valint].type == FLOAT && reg[t].type == FLOAT)
+      else if (a.type == FLOAT && b.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat / reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat / b.attr.valfloat ;
+        d.type = FLOAT;
       }
-      else if (reg[s.attr.valint].type == FLOAT)
+      else if (a.type == FLOAT)
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valfloat / reg[t].attr.valint ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valfloat / b.attr.valint ;
+        d.type = FLOAT;
       }
       else
       {
-        reg[r].attr.valfloat = reg[s.attr.valint].attr.valint / reg[t].attr.valfloat ;
-        reg[r].type = FLOAT;
+        d.attr.valfloat = a.attr.valint / b.attr.valfloat ;
+        d.type = FLOAT;
       }
+      setReg(r, d) ;
       break;
 
     /*************** RM instructions ********************/
-    case opLD :    reg[r] = dMem[m.attr.valint] ;  break;
-    case opST :    dMem[m.attr.valint] = reg[r] ;  break;
+    case opLD :    setReg(r, getMem(m.attr.valint)) ;
+                   loadedAt = m.attr.valint ;  break;
+    case opST :    setMem(m.attr.valint, getReg(r)) ;
+                   storedAt = m.attr.valint ;  break;
 
     /*************** RA instructions ********************/
-    case opLDA :    reg[r] = m ; break;
-    case opLDC :    reg[r] = currentinstruction.iarg2 ;   break;
-    case opJLT :    if ( reg[r].attr.valint <  0 ) reg[PC_REG] = m ; break;
-    case opJLE :    if ( reg[r].attr.valint <=  0 ) reg[PC_REG] = m ; break;
-    case opJGT :    if ( reg[r].attr.valint >  0 ) reg[PC_REG] = m ; break;
-    case opJGE :    if ( reg[r].attr.valint >=  0 ) reg[PC_REG] = m ; break;
-    case opJEQ :    if ( reg[r].attr.valint == 0 ) reg[PC_REG] = m ; break;
-    case opJNE :    if ( reg[r].attr.valint != 0 ) reg[PC_REG] = m ; break;
+    case opLDA :
+    case opADDI :   setReg(r, m) ; break;
+    case opLDC :    setReg(r, currentinstruction.iarg2) ;   break;
+    case opMULI :
+      m = currentinstruction.iarg2 ;
+      if (m.type == INT && a.type == INT)
+        m.attr.valint *= a.attr.valint ;
+      else
+      {
+        if (m.type == INT) m.attr.valfloat = m.attr.valint ;
+        if (a.type == FLOAT)
+          m.attr.valfloat *= a.attr.valfloat;
+        else m.attr.valfloat *= a.attr.valint;
+        m.type = FLOAT;
+      }
+      setReg(r, m) ;
+      break;
+    case opJLT :    if ( regVal[r].valint <  0 ) setReg(PC_REG, m) ; break;
+    case opJLE :    if ( regVal[r].valint <=  0 ) setReg(PC_REG, m) ; break;
+    case opJGT :    if ( regVal[r].valint >  0 ) setReg(PC_REG, m) ; break;
+    case opJGE :    if ( regVal[r].valint >=  0 ) setReg(PC_REG, m) ; break;
+    case opJEQ :    if ( regVal[r].valint == 0 ) setReg(PC_REG, m) ; break;
+    case opJNE :    if ( regVal[r].valint != 0 ) setReg(PC_REG, m) ; break;
 
     /* end of legal instructions */
   } /* case */
   return srOKAY ;
 } /* stepTM */
 
+/* debugging features of a run loop; each one is
+ * compiled into runLoop<F> only when set in F
+ */
+#define fTRACE  1   /* print each instruction before executing it */
+#define fBREAK  2   /* stop before a location set in breakAt */
+#define fWATCH  4   /* stop after a store to a location set in watchAt */
+#define fLIMIT  8   /* stop once runLimit instructions have executed */
+#define fPROF   16  /* count into profCount ... profWrites */
+#define fRECORD 32  /* write a TRACERECORD to traceRing */
+#define fBUDGET 64  /* stop at a jump once runLimit instructions have
+                     * executed: no hooks, superinstructions kept */
+
 /********************************************/
-int doCommand (void)
-{ char cmd;
-  int stepcnt=0, i;
-  int printcnt;
-  int stepResult;
-  int regNo, loc;
-  do
-  { printf ("Enter command: ");
-    fflush (stdin);
-    fflush (stdout);
-    gets(in_Line);
-    lineLen = strlen(in_Line);
-    inCol = 0;
+/* Function runLoop executes the decoded    */
+/* program from reg(PC_REG) until a step    */
+/* result other than srOKAY, and stores the */
+/* number of instructions executed in       */
+/* *icount. With GNU C it uses direct-      */
+/* threaded dispatch (labels as values)     */
+/* over dCode and keeps the register file   */
+/* and its type bits in locals, which are   */
+/* written back on exit. Straight-line code */
+/* runs with no pc bookkeeping: the         */
+/* instruction count is taken from bp, the  */
+/* entry of the current block, when control */
+/* leaves it, and only dynamic jumps are    */
+/* bounds checked. runLoop<0> is the bare   */
+/* loop; with any feature in F, dispatch    */
+/* goes through the hooks and the dispatch  */
+/* table, and superinstructions run as      */
+/* their first instruction so that every    */
+/* location is seen                         */
+/********************************************/
+#if defined(__GNUC__)
+
+/* dispatch the instruction at ip */
+#define NEXT()                                                      \
+  { if ( F != 0 )                                                   \
+    { if ( F & ~fBUDGET ) HOOKS() ;                                 \
+      goto *dispatch[ip->dop] ;                                     \
+    }                                                               \
+    goto *ip->handler ;                                             \
   }
-  while (! getWord ());
 
-  cmd = word[0] ;
-  switch ( cmd )
-  { case 't' :
-    /***********************************/
-      traceflag = ! traceflag ;
-      printf("Tracing now ");
-      if ( traceflag ) printf("on.\n"); else printf("off.\n");
-      break;
+/* the enabled features, before the instruction at ip; the
+ * first instruction of a run does not stop at its breakpoint
+ */
+#define HOOKS()                                                     \
+  { if ( (F & fLIMIT) && (n + (ip - bp) >= limit) )                 \
+      PAUSE(srOKAY) ;                                               \
+    if ( (F & fBREAK) && entered && breakAt[ip - dCode] )           \
+      PAUSE(srBREAK) ;                                              \
+    entered = TRUE ;                                                \
+    if ( F & fPROF ) PROFILE(ip - dCode) ;                          \
+    if ( F & fRECORD ) RECORD(ip - dCode) ;                         \
+    if ( F & fTRACE ) writeInstruction(ip - dCode) ;                \
+  }
 
-    case 'h' :
-    /***********************************/
-      printf("Commands are:\n");
-      printf("   s(tep <n>      "\
-             "Execute n (default 1) TM instructions\n");
-      printf("   g(o            "\
-             "Execute TM instructions until HALT\n");
-      printf("   r(egs          "\
-             "Print the contents of the registers\n");
-      printf("   i(Mem <b <n>>  "\
-             "Print n iMem locations starting at b\n");
-      printf("   d(Mem <b <n>>  "\
-             "Print n dMem locations starting at b\n");
-      printf("   t(race         "\
-             "Toggle instruction trace\n");
-      printf("   p(rint         "\
-             "Toggle print of total instructions executed"\
-             " ('go' only)\n");
-      printf("   c(lear         "\
-             "Reset simulator for new execution of program\n");
-      printf("   h(elp          "\
-             "Cause this list of commands to be printed\n");
-      printf("   q(uit          "\
-             "Terminate the simulation\n");
-      break;
+/* count an execution of slot l, and the jump to it from last
+ * when it does not follow last
+ */
+#define PROFILE(l)                                                  \
+  { int _l = (l) ;                                                  \
+    profCount[_l]++ ;                                               \
+    if ( (last >= 0) && (_l != last + 1) )                          \
+    { profTaken[last]++ ;                                           \
+      if ( _l <= last ) { profBack[last]++ ; profBackTo[last] = _l ; } \
+    }                                                               \
+    last = _l ;                                                     \
+  }
 
-    case 'p' :
-    /***********************************/
-      icountflag = ! icountflag ;
-      printf("Printing instruction count now ");
-      if ( icountflag ) printf("on.\n"); else printf("off.\n");
-      break;
+/* start the record of slot l, finishing the one before; the
+ * address is taken before the instruction may change its base
+ */
+#define RECORD(l)                                                   \
+  { INSTRUCTION * _i = &iMem[l] ;                                   \
+    ENDRECORD() ;                                                   \
+    rec = &traceRing[traceCount++ & traceMask] ;                    \
+    rec->pc = (l) ;                                                 \
+    rec->op = _i->iop ;                                             \
+    rec->reg = _i->iarg1 ;                                          \
+    rec->addr = ( ((_i->iop == opLD) || (_i->iop == opST))          \
+                  && (_i->iarg2.type == INT) && ! RF(_i->iarg3) )   \
+                ? _i->iarg2.attr.valint + r[_i->iarg3].valint : -1 ; \
+  }
 
-    case 's' :
-    /***********************************/
-      if ( atEOL ())  stepcnt = 1;
-      else if ( getNum ())  stepcnt = abs(num);
-      else   printf("Step count?\n");
-      break;
+/* the register value of the last record */
+#define ENDRECORD()                                                 \
+  { if ( (F & fRECORD) && (rec != NULL) )                           \
+    { rec->value = r[rec->reg] ;                                    \
+      rec->isFloat = RF(rec->reg) ;                                 \
+    }                                                               \
+  }
 
-    case 'g' :   stepcnt = 1 ;     break;
+/* stop before the instruction at ip */
+#define PAUSE(res)                                                  \
+  { n += ip - bp ; result = (res) ; pc = ip - dCode ; goto done ; }
 
-    case 'r' :
-    /***********************************/
-      for (i = 0; i < NO_REGS; i++)
-      {
-        printf("%1d: ", i);
-        if (reg[i].type == INT)
-          printf("%4d    ", reg[i].attr.valint);
-        else
-          printf("%.2f    ", reg[i].attr.valfloat);
-        if ( (i % 4) == 3 ) printf ("\n");
+/* trace a location that faults before dispatch */
+#define TRACEAT(t)  { if ( F & fTRACE ) writeInstruction(t) ; }
+
+/* a superinstruction runs as its first instruction in a hooked loop */
+#define UNFUSE(l)   { if ( F & ~fBUDGET ) goto l ; }
+
+/* stop on entering a block once the budget is spent */
+#define BUDGET()    { if ( (F & fBUDGET) && (n >= limit) ) PAUSE(srOKAY) ; }
+
+/* fall through to the next instruction */
+#define FALL()    { ip++ ; NEXT() ; }
+
+/* leave the current block at ip */
+#define LEAVE()   ( n += ip - bp + 1 )
+
+/* transfer control to the block leader t */
+#define JUMPK(t)  { LEAVE() ; ip = bp = dCode + (t) ; BUDGET() ; NEXT() ; }
+
+/* transfer control to location t */
+#define JUMP(t)                                                     \
+  { int _t = (t) ;                                                  \
+    LEAVE() ;                                                       \
+    if ( (_t < 0) || (_t >= isize) )                                \
+    { TRACEAT(_t) ;                                                 \
+      n++ ; pc = _t ; result = srIMEM_ERR ; goto done ;             \
+    }                                                               \
+    ip = bp = dCode + _t ;                                          \
+    BUDGET() ;                                                      \
+    NEXT() ;                                                        \
+  }
+
+/* stop after the instruction at ip */
+#define STOP(res)                                                   \
+  { LEAVE() ; result = (res) ; pc = ip - dCode + 1 ; goto done ; }
+
+/* type bit of reg(i) and of mem(a); register types are kept a
+ * byte each in rt[] so that type writes are plain stores and do
+ * not chain through one word
+ */
+#define RF(i)     ( rt[i] )
+#define MF(a)     ( (dFloat[(a) >> 5] >> ((a) & 31)) & 1u )
+
+/* rt[] from regFloat and back */
+#define GETTYPES()                                                  \
+  { for (i = 0 ; i < NO_REGS ; i++) rt[i] = (regFloat >> i) & 1u ; }
+#define PUTTYPES()                                                  \
+  { regFloat = 0 ;                                                  \
+    for (i = 0 ; i < NO_REGS ; i++) regFloat |= (unsigned)rt[i] << i ; \
+  }
+
+/* reg(i) as a float */
+#define FV(i)     ( RF(i) ? r[i].valfloat : (float)r[i].valint )
+
+/* set the type bit of reg(i) to f */
+#define SETRF(i, f)  ( rt[i] = (unsigned char)(f) )
+
+/* reg(d) = mem(a), mem(a) = reg(d), branch-free on the type */
+#define LOAD(d, a)                                                  \
+  { r[d] = dVal[a] ; SETRF(d, MF(a)) ;                              \
+    if ( F & fPROF ) profReads[a]++ ;                               \
+  }
+#define STORE(a, d)                                                 \
+  { dVal[a] = r[d] ;                                                \
+    if ( F & fPROF ) profWrites[a]++ ;                              \
+    dFloat[(a) >> 5] = (dFloat[(a) >> 5] & ~(1u << ((a) & 31)))     \
+                       | (RF(d) << ((a) & 31)) ;                    \
+    if ( (F & fWATCH) && watchAt[a] )                               \
+    { watchHit = (a) ;                                              \
+      STOP(srWATCH) ;                                               \
+    }                                                               \
+  }
+
+/* v = reg(s) op reg(t), vf = its type: int-int or float */
+#define ARITHTO(v, vf, s, t, op)                                    \
+  { if ( (RF(s) | RF(t)) == 0 )                                     \
+    { v.valint = r[s].valint op r[t].valint ; vf = 0 ; }            \
+    else                                                            \
+    { v.valfloat = FV(s) op FV(t) ; vf = 1 ; }                      \
+  }
+
+/* v = reg(s) op reg(t), as ARITHTO with no type */
+#define ARITHV(v, s, t, op)                                         \
+  { if ( (RF(s) | RF(t)) == 0 )                                     \
+      v.valint = r[s].valint op r[t].valint ;                       \
+    else                                                            \
+      v.valfloat = FV(s) op FV(t) ;                                 \
+  }
+
+/* reg(r) = reg(s) op reg(t) */
+#define ARITH(op)                                                   \
+  { WORD v ; unsigned vf ;                                          \
+    ARITHTO(v, vf, ip->s, ip->t, op) ;                              \
+    r[ip->r] = v ;                                                  \
+    SETRF(ip->r, vf) ;                                              \
+    FALL() ;                                                        \
+  }
+
+/* reg(r) = (reg(s)-reg(t)) cond 0, resuming 5 slots on; the
+ * original sequence executes 3 instructions if the branch is
+ * taken and 4 if not, so the block count is corrected
+ */
+#define COMPARE(cond)                                               \
+  { WORD v ;                                                        \
+    ARITHV(v, ip->s, ip->t, -) ;                                    \
+    if ( v.valint cond 0 ) { r[ip->r].valint = 1 ; n -= 2 ; }       \
+    else { r[ip->r].valint = 0 ; n -= 1 ; }                         \
+    SETRF(ip->r, 0u) ;                                              \
+    ip += 5 ;                                                       \
+    NEXT() ;                                                        \
+  }
+
+/* if reg(r) cond 0 then reg(7) = k */
+#define BRANCH(cond)                                                \
+  { if ( r[ip->r].valint cond 0 ) JUMPK(ip->k.valint) ;             \
+    FALL() ;                                                        \
+  }
+
+/* if reg(r) cond 0 then reg(7) = k+reg(s) */
+#define BRANCHR(cond)                                               \
+  { if ( RF(ip->s) ) goto lSLOW ;                                   \
+    if ( r[ip->r].valint cond 0 )                                   \
+      JUMP(ip->k.valint + r[ip->s].valint) ;                        \
+    FALL() ;                                                        \
+  }
+
+template <int F> STEPRESULT runLoop ( long * icount )
+{ static void * dispatch[dopLIM] =
+    { &&lSLOW, &&lIMEM, &&lDMEM, &&lHALT, &&lIN, &&lOUT,
+      &&lADD, &&lSUB, &&lXOR, &&lMUL, &&lDIV,
+      &&lLD, &&lST, &&lLDK, &&lSTK, &&lLDU, &&lSTU, &&lLDPC,
+      &&lLDA, &&lLDCI, &&lLDCF, &&lMULI, &&lJMP, &&lJMPR,
+      &&lJLT, &&lJLE, &&lJGT, &&lJGE, &&lJEQ, &&lJNE,
+      &&lJLTR, &&lJLER, &&lJGTR, &&lJGER, &&lJEQR, &&lJNER,
+      &&lCMPLT, &&lCMPLE, &&lCMPGT, &&lCMPGE, &&lCMPEQ, &&lCMPNE,
+      &&lPUSHLD, &&lPUSHLDC
+    } ;
+  WORD r[NO_REGS] ;
+  unsigned char rt[NO_REGS] ;
+  NUM v ;
+  DINSTRUCTION * ip, * bp ;
+  int pc, a, i ;
+  int isize = iaddrSize, dsize = daddrSize ;
+  int entered = FALSE, last = -1 ;
+  TRACERECORD * rec = NULL ;
+  long n = 0, limit = runLimit ;
+  STEPRESULT result ;
+
+  if ( (F == 0) && ! dCodeThreaded )
+  { for (pc = 0 ; pc <= isize ; pc++)
+      dCode[pc].handler = dispatch[dCode[pc].dop] ;
+    dCodeThreaded = TRUE ;
+  }
+  if ( icount == NULL ) return srOKAY ;   /* threadInstructions */
+  memcpy(r, regVal, sizeof(r)) ;
+  GETTYPES() ;
+  pc = r[PC_REG].valint ;
+  if ( (pc < 0) || (pc >= isize) )
+  { TRACEAT(pc) ;
+    n++ ;
+    result = srIMEM_ERR ;
+    goto done ;
+  }
+  ip = bp = dCode + pc ;
+  NEXT() ;
+
+lSLOW :   /* anything not specialized: one step of stepTM */
+  LEAVE() ;
+  memcpy(regVal, r, sizeof(r)) ;
+  PUTTYPES() ;
+  regVal[PC_REG].valint = ip - dCode ; regFloat &= ~(1u << PC_REG) ;
+  storedAt = loadedAt = -1 ;
+  result = stepTM () ;
+  if ( (F & fWATCH) && (result == srOKAY) && (storedAt >= 0) && watchAt[storedAt] )
+  { watchHit = storedAt ;
+    result = srWATCH ;
+  }
+  if ( (F & fPROF) && (loadedAt >= 0) ) profReads[loadedAt]++ ;
+  if ( (F & fPROF) && (storedAt >= 0) ) profWrites[storedAt]++ ;
+  if ( result == srNO_INPUT ) n-- ;
+  memcpy(r, regVal, sizeof(r)) ;
+  GETTYPES() ;
+  pc = r[PC_REG].valint ;
+  if ( (result == srOKAY) && ((pc < 0) || (pc >= isize)) )
+  { TRACEAT(pc) ;
+    n++ ;
+    result = srIMEM_ERR ;
+  }
+  if ( result != srOKAY )
+  { ENDRECORD() ;
+    *icount = n ;   /* regVal[] is already up to date */
+    return result ;
+  }
+  ip = bp = dCode + pc ;
+  BUDGET() ;
+  NEXT() ;
+lIMEM :   /* fell off the end of iMem */
+  LEAVE() ;
+  pc = isize ;
+  result = srIMEM_ERR ;
+  goto done ;
+lDMEM :   /* constant address out of range */
+  STOP(srDMEM_ERR) ;
+lHALT :
+  flushOut () ;
+  if ( msgOut != NULL )
+    fprintf(msgOut, "HALT: %1d,%1d,%1d\n",ip->r,ip->k.valint,ip->t);
+  STOP(srHALT) ;
+lIN :
+  if ( ! readIn(&v) ) PAUSE(srNO_INPUT) ;
+  r[ip->r].valint = v.attr.valint ;
+  SETRF(ip->r, (unsigned)(v.type == FLOAT)) ;
+  FALL() ;
+lOUT :
+  v.attr.valint = r[ip->r].valint ;
+  v.type = RF(ip->r) ? FLOAT : INT ;
+  writeOut(v) ;
+  FALL() ;
+lADD : ARITH(+)
+lSUB : ARITH(-)
+lMUL : ARITH(*)
+lXOR :
+  if ( RF(ip->s) | RF(ip->t) ) STOP(srTYPE_ERR) ;
+  r[ip->r].valint = r[ip->s].valint ^ r[ip->t].valint ;
+  SETRF(ip->r, 0u) ;
+  FALL() ;
+lDIV :
+  /* same test as reg(t).valfloat == 0, on the bits */
+  if ( (r[ip->t].valint & 0x7fffffff) == 0 ) STOP(srZERODIVIDE) ;
+  ARITH(/)
+lLD :
+  if ( RF(ip->s) ) STOP(srMEM_FLOAT) ;
+  a = ip->k.valint + r[ip->s].valint ;
+  if ( (a < 0) || (a >= dsize) ) STOP(srDMEM_ERR) ;
+  LOAD(ip->r, a) ;
+  FALL() ;
+lST :
+  if ( RF(ip->s) ) STOP(srMEM_FLOAT) ;
+  a = ip->k.valint + r[ip->s].valint ;
+  if ( (a < 0) || (a >= dsize) ) STOP(srDMEM_ERR) ;
+  STORE(a, ip->r) ;
+  FALL() ;
+lLDK :
+  LOAD(ip->r, ip->k.valint) ;
+  FALL() ;
+lSTK :
+  STORE(ip->k.valint, ip->r) ;
+  FALL() ;
+lLDU :
+  a = ip->k.valint + r[ip->s].valint ;
+  LOAD(ip->r, a) ;
+  FALL() ;
+lSTU :
+  a = ip->k.valint + r[ip->s].valint ;
+  STORE(a, ip->r) ;
+  FALL() ;
+lLDPC :
+  if ( RF(ip->s) ) STOP(srMEM_FLOAT) ;
+  a = ip->k.valint + r[ip->s].valint ;
+  if ( (a < 0) || (a >= dsize) ) STOP(srDMEM_ERR) ;
+  if ( MF(a) ) goto lSLOW ;
+  if ( F & fPROF ) profReads[a]++ ;
+  JUMP(dVal[a].valint) ;
+lLDA :
+  if ( RF(ip->s) ) goto lSLOW ;
+  r[ip->r].valint = ip->k.valint + r[ip->s].valint ;
+  SETRF(ip->r, 0u) ;
+  FALL() ;
+lLDCI :
+  r[ip->r].valint = ip->k.valint ;
+  SETRF(ip->r, 0u) ;
+  FALL() ;
+lLDCF :
+  r[ip->r].valfloat = ip->k.valfloat ;
+  SETRF(ip->r, 1u) ;
+  FALL() ;
+lMULI :
+  if ( RF(ip->s) ) goto lSLOW ;
+  r[ip->r].valint = ip->k.valint * r[ip->s].valint ;
+  SETRF(ip->r, 0u) ;
+  FALL() ;
+lJMP :
+  JUMPK(ip->k.valint) ;
+lJMPR :
+  if ( RF(ip->s) ) goto lSLOW ;
+  JUMP(ip->k.valint + r[ip->s].valint) ;
+lJLT : BRANCH(<)
+lJLE : BRANCH(<=)
+lJGT : BRANCH(>)
+lJGE : BRANCH(>=)
+lJEQ : BRANCH(==)
+lJNE : BRANCH(!=)
+lJLTR : BRANCHR(<)
+lJLER : BRANCHR(<=)
+lJGTR : BRANCHR(>)
+lJGER : BRANCHR(>=)
+lJEQR : BRANCHR(==)
+lJNER : BRANCHR(!=)
+lCMPLT : UNFUSE(lSUB) COMPARE(<)
+lCMPLE : UNFUSE(lSUB) COMPARE(<=)
+lCMPGT : UNFUSE(lSUB) COMPARE(>)
+lCMPGE : UNFUSE(lSUB) COMPARE(>=)
+lCMPEQ : UNFUSE(lSUB) COMPARE(==)
+lCMPNE : UNFUSE(lSUB) COMPARE(!=)
+lPUSHLD :   /* the LD t,k(s) is forwarded from the ST */
+  UNFUSE(lST) ;
+  if ( RF(ip->s) ) goto lST ;
+  a = ip->k.valint + r[ip->s].valint ;
+  if ( (a < 0) || (a >= dsize) ) goto lST ;
+  pc = ip[1].k.valint ;
+  if ( ip[1].dop == dopLD )
+  { if ( RF(ip[1].s) ) goto lST ;
+    pc += r[ip[1].s].valint ;
+    if ( (pc < 0) || (pc >= dsize) ) goto lST ;
+  }
+  STORE(a, ip->r) ;
+  LOAD(ip[1].r, pc) ;
+  LOAD(ip[2].r, a) ;
+  ip += 3 ;
+  NEXT() ;
+lPUSHLDC :
+  UNFUSE(lST) ;
+  if ( RF(ip->s) ) goto lST ;
+  a = ip->k.valint + r[ip->s].valint ;
+  if ( (a < 0) || (a >= dsize) ) goto lST ;
+  STORE(a, ip->r) ;
+  r[ip[1].r].valint = ip[1].k.valint ;
+  SETRF(ip[1].r, (unsigned)(ip[1].dop == dopLDCF)) ;
+  LOAD(ip[2].r, a) ;
+  ip += 3 ;
+  NEXT() ;
+
+done :
+  ENDRECORD() ;
+  memcpy(regVal, r, sizeof(r)) ;
+  PUTTYPES() ;
+  regVal[PC_REG].valint = pc ; regFloat &= ~(1u << PC_REG) ;
+  *icount = n ;
+  return result ;
+} /* runLoop */
+
+#undef NEXT
+#undef HOOKS
+#undef PROFILE
+#undef RECORD
+#undef ENDRECORD
+#undef PAUSE
+#undef TRACEAT
+#undef UNFUSE
+#undef BUDGET
+#undef FALL
+#undef LEAVE
+#undef JUMPK
+#undef JUMP
+#undef STOP
+#undef RF
+#undef MF
+#undef GETTYPES
+#undef PUTTYPES
+#undef FV
+#undef SETRF
+#undef LOAD
+#undef STORE
+#undef ARITHTO
+#undef ARITHV
+#undef ARITH
+#undef COMPARE
+#undef BRANCH
+#undef BRANCHR
+
+#else
+
+template <int F> STEPRESULT runLoop ( long * icount )
+{ STEPRESULT result = srOKAY ;
+  long n = 0 ;
+  long limit = runLimit ;
+  int pc, entered = FALSE, last = -1 ;
+  if ( icount == NULL ) return srOKAY ;
+  for (;;)
+  { pc = regVal[PC_REG].valint ;
+    if ( (F & (fLIMIT | fBUDGET)) && (n >= limit) ) break;
+    if ( (F & fBREAK) && entered && (pc >= 0) && (pc < iaddrSize) && breakAt[pc] )
+    { result = srBREAK ;
+      break;
+    }
+    entered = TRUE ;
+    if ( (F & fPROF) && (pc >= 0) && (pc < iaddrSize) )
+    { profCount[pc]++ ;
+      if ( (last >= 0) && (pc != last + 1) )
+      { profTaken[last]++ ;
+        if ( pc <= last ) { profBack[last]++ ; profBackTo[last] = pc ; }
       }
+      last = pc ;
+    }
+    if ( F & fTRACE ) writeInstruction(pc) ;
+    storedAt = loadedAt = -1 ;
+    result = stepTM () ;
+    if ( result != srNO_INPUT ) n++ ;
+    if ( (F & fRECORD) && (pc >= 0) && (pc < iaddrSize) )
+    { TRACERECORD * rec = &traceRing[traceCount++ & traceMask] ;
+      rec->pc = pc ;
+      rec->op = iMem[pc].iop ;
+      rec->reg = iMem[pc].iarg1 ;
+      rec->isFloat = getReg(rec->reg).type == FLOAT ;
+      rec->value = regVal[rec->reg] ;
+      rec->addr = (loadedAt >= 0) ? loadedAt : storedAt ;
+    }
+    if ( (F & fPROF) && (loadedAt >= 0) ) profReads[loadedAt]++ ;
+    if ( (F & fPROF) && (storedAt >= 0) ) profWrites[storedAt]++ ;
+    if ( result != srOKAY ) break;
+    if ( (F & fWATCH) && (storedAt >= 0) && watchAt[storedAt] )
+    { watchHit = storedAt ;
+      result = srWATCH ;
       break;
+    }
+  }
+  *icount = n ;
+  return result ;
+} /* runLoop */
 
-    case 'i' :
-    /***********************************/
-      printcnt = 1 ;
-      if ( getNum ())
-      { iloc = num ;
-        if ( getNum ()) printcnt = num ;
-      }
-      if ( ! atEOL ())
-        printf ("Instruction locations?\n");
-      else
-      { while ((iloc >= 0) && (iloc < IADDR_SIZE)
-                && (printcnt > 0) )
-        { writeInstruction(iloc);
-          iloc++ ;
-          printcnt-- ;
+#endif
+
+/********************************************/
+void threadInstructions (void)
+{ if ( ! dCodeThreaded ) runLoop<0> (NULL) ;
+} /* threadInstructions */
+
+/********************************************/
+STEPRESULT runTM ( long * icount )
+{ return runLoop<0> (icount) ;
+} /* runTM */
+
+/********************************************/
+/* Function runFor is runTM stopping with   */
+/* srOKAY at the first jump after limit     */
+/* instructions, if limit > 0               */
+/********************************************/
+STEPRESULT runFor ( long * icount, long limit )
+{ if ( limit <= 0 ) return runLoop<0> (icount) ;
+  runLimit = limit ;
+  return runLoop<fBUDGET> (icount) ;
+} /* runFor */
+
+/********************************************/
+/* Function runDebug is runTM for the g(o   */
+/* command: it picks the runLoop compiled   */
+/* for the features in use, stopping after  */
+/* at most limit instructions if limit > 0  */
+/********************************************/
+STEPRESULT runDebug ( long * icount, long limit )
+{ static STEPRESULT (* const loops[fPROF]) (long *) =
+    { runLoop<0>,  runLoop<1>,  runLoop<2>,  runLoop<3>,
+      runLoop<4>,  runLoop<5>,  runLoop<6>,  runLoop<7>,
+      runLoop<8>,  runLoop<9>,  runLoop<10>, runLoop<11>,
+      runLoop<12>, runLoop<13>, runLoop<14>, runLoop<15>
+    } ;
+  runLimit = limit ;
+  return loops[ (traceflag ? fTRACE : 0) | ((nBreaks > 0) ? fBREAK : 0)
+                | ((nWatches > 0) ? fWATCH : 0) | ((limit > 0) ? fLIMIT : 0) ]
+               (icount) ;
+} /* runDebug */
+
+/********************************************/
+/* Function wallClock returns seconds from  */
+/* an arbitrary origin                      */
+/********************************************/
+double wallClock (void)
+{
+#if defined(__unix__)
+  struct timespec t ;
+  clock_gettime(CLOCK_MONOTONIC, &t) ;
+  return t.tv_sec + t.tv_nsec * 1e-9 ;
+#else
+  return (double) clock () / CLOCKS_PER_SEC ;
+#endif
+} /* wallClock */
+
+/********************************************/
+/* Function peakMemory returns the peak     */
+/* resident size of the process in kB, or 0 */
+/* if it is not known                       */
+/********************************************/
+long peakMemory (void)
+{
+#if defined(__unix__)
+  struct rusage u ;
+  if ( getrusage(RUSAGE_SELF, &u) == 0 ) return u.ru_maxrss ;
+#endif
+  return 0 ;
+} /* peakMemory */
+
+/* the key qsort orders locations by, largest first */
+long * sortKey ;
+
+int bySortKey ( const void * a, const void * b )
+{ long ka = sortKey[*(const int *) a], kb = sortKey[*(const int *) b] ;
+  if ( ka != kb ) return (ka < kb) ? 1 : -1 ;
+  return *(const int *) a - *(const int *) b ;
+} /* bySortKey */
+
+/* Function sortedBy returns the n locations in
+ * 0..size-1 with a nonzero key, largest key first
+ */
+int * sortedBy ( long * key, int size, int * n )
+{ int * locs = (int *) malloc((size + 1) * sizeof(int)) ;
+  int i ;
+  *n = 0 ;
+  for (i = 0 ; i < size ; i++)
+    if ( key[i] != 0 ) locs[(*n)++] = i ;
+  sortKey = key ;
+  qsort(locs, *n, sizeof(int), bySortKey) ;
+  return locs ;
+} /* sortedBy */
+
+/* Procedure jsonString writes s as a JSON string */
+void jsonString ( FILE * f, char * s )
+{ fputc('"', f) ;
+  for ( ; *s ; s++)
+  { if ( (*s == '"') || (*s == '\\') ) fputc('\\', f) ;
+    if ( (unsigned char) *s >= ' ' ) fputc(*s, f) ;
+  }
+  fputc('"', f) ;
+} /* jsonString */
+
+/********************************************/
+/* Procedure writeProfile writes the        */
+/* profile of a run as an annotated listing */
+/* to base.prof and as a JSON report to     */
+/* base.prof.json                           */
+/********************************************/
+void writeProfile ( char * base, STEPRESULT result, long icount,
+                    double secs )
+{ char name[sizeof(pgmName) + 16] ;
+  FILE * f ;
+  long * body, * access ;
+  int * loops, * cells ;
+  int nLoops, nCells, top, loc, a, i, len ;
+  long kb = peakMemory () ;
+  double ips = (secs > 0) ? icount / secs : 0 ;
+
+  /* the program: up to the last loaded or executed slot */
+  for (top = iaddrSize ; top > 0 ; top--)
+    if ( (profCount[top-1] != 0) || (iMem[top-1].iop != opHALT)
+         || (iMem[top-1].iarg1 != 0) || (iMem[top-1].iarg2.attr.valint != 0)
+         || (iMem[top-1].iarg3 != 0) ) break;
+
+  /* loops by back edge, instructions executed in each body */
+  loops = sortedBy(profBack, iaddrSize, &nLoops) ;
+  body = (long *) calloc(nLoops + 1, sizeof(long)) ;
+  for (i = 0 ; i < nLoops ; i++)
+    for (loc = profBackTo[loops[i]] ; loc <= loops[i] ; loc++)
+      body[i] += profCount[loc] ;
+
+  /* dMem by reads plus writes */
+  access = (long *) mapZero((size_t) daddrSize * sizeof(long)) ;
+  for (a = 0 ; a < daddrSize ; a++)
+    access[a] = profReads[a] + profWrites[a] ;
+  cells = sortedBy(access, daddrSize, &nCells) ;
+
+  sprintf(name, "%s.prof", base) ;
+  f = fopen(name, "w") ;
+  if ( f == NULL ) { printf("cannot write '%s'\n", name) ; return ; }
+  fprintf(f, "TM profile of %s: %s\n", pgmName, stepResultTab[result]) ;
+  fprintf(f, "%ld instructions in %.6f s, %.0f instructions/s,"
+             " peak memory %ld kB\n\n", icount, secs, ips, kb) ;
+  fprintf(f, "     count      %%   loc  instruction\n") ;
+  for (loc = 0 ; loc < top ; loc++)
+  { if ( profCount[loc] != 0 )
+      fprintf(f, "%10ld %6.2f %5d: ", profCount[loc],
+              100.0 * profCount[loc] / icount, loc) ;
+    else fprintf(f, "%10s %6s %5d: ", "-", "", loc) ;
+    len = printInstruction(f, loc) ;
+    if ( (profCount[loc] != 0) && (iMem[loc].iop >= opJLT)
+         && (iMem[loc].iop <= opJNE) )
+    { fprintf(f, "%*s  taken %ld, not taken %ld", 20 - len, "",
+              profTaken[loc], profCount[loc] - profTaken[loc]) ;
+      len = 20 ;
+    }
+    if ( profBack[loc] != 0 )
+      fprintf(f, "%*s  loop to %d x %ld", 20 - len, "",
+              profBackTo[loc], profBack[loc]) ;
+    fprintf(f, "\n") ;
+  }
+  fprintf(f, "\nhot loops (back edge, iterations, instructions in body)\n") ;
+  for (i = 0 ; (i < nLoops) && (i < 10) ; i++)
+    fprintf(f, "%5d -> %-5d %10ld %12ld %6.2f%%\n", loops[i],
+            profBackTo[loops[i]], profBack[loops[i]], body[i],
+            100.0 * body[i] / icount) ;
+  fprintf(f, "\nhot data (location, reads, writes)\n") ;
+  for (i = 0 ; (i < nCells) && (i < 10) ; i++)
+    fprintf(f, "%5d %10ld %10ld\n", cells[i],
+            profReads[cells[i]], profWrites[cells[i]]) ;
+  fclose(f) ;
+
+  sprintf(name, "%s.prof.json", base) ;
+  f = fopen(name, "w") ;
+  if ( f == NULL ) { printf("cannot write '%s'\n", name) ; return ; }
+  fprintf(f, "{\n  \"program\": ") ;
+  jsonString(f, pgmName) ;
+  fprintf(f, ",\n  \"result\": ") ;
+  jsonString(f, stepResultTab[result]) ;
+  fprintf(f, ",\n  \"instructions\": %ld,\n  \"seconds\": %.6f,\n"
+             "  \"instructions_per_second\": %.0f,\n  \"peak_memory_kb\": %ld,\n",
+          icount, secs, ips, kb) ;
+  fprintf(f, "  \"slots\": [") ;
+  for (i = 0, loc = 0 ; loc < top ; loc++)
+    if ( profCount[loc] != 0 )
+    { fprintf(f, "%s\n    {\"loc\": %d, \"op\": \"%s\", \"count\": %ld",
+              i++ ? "," : "", loc, opCodeTab[iMem[loc].iop], profCount[loc]) ;
+      if ( (iMem[loc].iop >= opJLT) && (iMem[loc].iop <= opJNE) )
+        fprintf(f, ", \"taken\": %ld, \"not_taken\": %ld",
+                profTaken[loc], profCount[loc] - profTaken[loc]) ;
+      fprintf(f, "}") ;
+    }
+  fprintf(f, "\n  ],\n  \"loops\": [") ;
+  for (i = 0 ; i < nLoops ; i++)
+    fprintf(f, "%s\n    {\"from\": %d, \"to\": %d, \"iterations\": %ld,"
+               " \"instructions\": %ld}", i ? "," : "", loops[i],
+            profBackTo[loops[i]], profBack[loops[i]], body[i]) ;
+  fprintf(f, "\n  ],\n  \"dmem\": [") ;
+  for (i = 0 ; i < nCells ; i++)
+    fprintf(f, "%s\n    {\"addr\": %d, \"reads\": %ld, \"writes\": %ld}",
+            i ? "," : "", cells[i], profReads[cells[i]], profWrites[cells[i]]) ;
+  fprintf(f, "\n  ]\n}\n") ;
+  fclose(f) ;
+  free(loops) ;
+  free(body) ;
+  free(cells) ;
+} /* writeProfile */
+
+/********************************************/
+/* Function runProfile is runTM for the     */
+/* --profile option: it runs the program    */
+/* counting every slot, jump and dMem       */
+/* access and writes the profile next to    */
+/* the program                              */
+/********************************************/
+STEPRESULT runProfile ( long * icount )
+{ char base[sizeof(pgmName)] ;
+  char * dot ;
+  STEPRESULT result ;
+  double start ;
+  profCount = (long *) mapZero((size_t) iaddrSize * sizeof(long)) ;
+  profTaken = (long *) mapZero((size_t) iaddrSize * sizeof(long)) ;
+  profBack = (long *) mapZero((size_t) iaddrSize * sizeof(long)) ;
+  profBackTo = (int *) mapZero((size_t) iaddrSize * sizeof(int)) ;
+  profReads = (long *) mapZero((size_t) daddrSize * sizeof(long)) ;
+  profWrites = (long *) mapZero((size_t) daddrSize * sizeof(long)) ;
+  start = wallClock () ;
+  result = runLoop<fPROF> (icount) ;
+  start = wallClock () - start ;
+  strcpy(base, pgmName) ;
+  dot = strrchr(base, '.') ;
+  if ( (dot != NULL) && (strchr(dot, '/') == NULL) ) *dot = '\0' ;
+  writeProfile(base, result, *icount, start) ;
+  return result ;
+} /* runProfile */
+
+/********************************************/
+/* Procedure openTrace creates the trace    */
+/* file name with a ring of records, a      */
+/* power of 2, and maps it when it can      */
+/********************************************/
+void openTrace ( char * name, long records )
+{ size_t size = sizeof(TRACEHEADER) + records * sizeof(TRACERECORD) ;
+  void * p = NULL ;
+#if defined(__linux__) && defined(__LP64__)
+  int fd = open(name, O_RDWR | O_CREAT | O_TRUNC, 0644) ;
+  if ( (fd >= 0) && (ftruncate(fd, size) == 0) )
+  { p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) ;
+    if ( p == MAP_FAILED ) p = NULL ;
+  }
+  if ( fd >= 0 ) close(fd) ;
+#endif
+  if ( p == NULL )
+  { traceFile = fopen(name, "wb") ;
+    if ( traceFile == NULL )
+    { printf("cannot write '%s'\n", name) ;
+      exit(1) ;
+    }
+    p = mapZero(size) ;
+  }
+  traceHead = (TRACEHEADER *) p ;
+  traceRing = (TRACERECORD *) (traceHead + 1) ;
+  memcpy(traceHead->magic, TRACE_MAGIC, sizeof(traceHead->magic)) ;
+  traceHead->records = (int) records ;
+  traceMask = records - 1 ;
+  traceCount = 0 ;
+} /* openTrace */
+
+/********************************************/
+/* Procedure closeTrace completes the       */
+/* header and writes out the trace          */
+/********************************************/
+void closeTrace ( STEPRESULT result )
+{ size_t size = sizeof(TRACEHEADER) + (traceMask + 1) * sizeof(TRACERECORD) ;
+  traceHead->result = result ;
+  traceHead->count = traceCount ;
+  if ( traceFile != NULL )
+  { fwrite(traceHead, 1, size, traceFile) ;
+    fclose(traceFile) ;
+  }
+#if defined(__linux__) && defined(__LP64__)
+  else munmap(traceHead, size) ;
+#endif
+} /* closeTrace */
+
+/********************************************/
+/* Function runTrace is runTM for the       */
+/* --trace option: it records every         */
+/* instruction executed in the trace file   */
+/* name, keeping the last records of them   */
+/********************************************/
+STEPRESULT runTrace ( long * icount, char * name, long records )
+{ STEPRESULT result ;
+  openTrace(name, records) ;
+  result = runLoop<fRECORD> (icount) ;
+  closeTrace(result) ;
+  return result ;
+} /* runTrace */
+
+/********************************************/
+/* x86-64 JIT: compileJIT translates dCode  */
+/* into native code, one template per      */
+/* instruction, with the TM registers and  */
+/* dMem addressed through a JITCONTEXT and */
+/* the register type bits held in r15d.    */
+/* Int operands run inline; any type, bound*/
+/* or divisor check that fails, and every  */
+/* form not translated, leaves native code */
+/* so runJIT can execute that instruction  */
+/* with stepTM. The instruction count is   */
+/* kept per basic block in r13             */
+/********************************************/
+#if defined(__x86_64__) && defined(__linux__)
+
+#define JIT_CODE_SIZE  ((size_t) iaddrSize * 256)
+#define JIT_CODE_MAX   ((size_t) 1 << 30)   /* reach of a rel32 */
+#define JIT_SHORT      32     /* a native run this short exits too often ... */
+#define JIT_BACKOFF    4096   /* ... so the interpreter runs this many more */
+
+typedef struct {
+      WORD * reg ;      /* rbx */
+      WORD * dMem ;     /* r12 */
+      unsigned * dFloat ; /* type bits of dMem */
+      long n ;          /* r13, instructions executed */
+      void ** entry ;   /* r14, native entry per location */
+      int pc ;          /* location to enter at / left at */
+   } JITCONTEXT;
+
+typedef enum { fixLABEL, fixSLOW } JITFIXKIND;
+
+typedef struct {
+      int at ;          /* offset of the rel32 to patch */
+      int loc ;         /* iMem location referred to */
+      JITFIXKIND kind ;
+   } JITFIXUP;
+
+/* per thread like the rest of the machine; the code refers
+ * to regFloat and inputEnded of the thread that compiled it
+ */
+TMLOCAL unsigned char * jitCode = NULL ;
+TMLOCAL int jitLen ;
+TMLOCAL void ** jitEntry ;
+TMLOCAL int * jitLabel ;           /* code offset of each location */
+TMLOCAL int * jitSlowStub ;        /* offset of its exit stub or -1 */
+TMLOCAL JITFIXUP * jitFix ;        /* at most 4 per location */
+TMLOCAL int nJitFix ;
+TMLOCAL int jitEntryAt ;           /* offset of the entry sequence */
+TMLOCAL int jitCompiled = FALSE ;
+
+void jitB ( int b ) { jitCode[jitLen++] = (unsigned char) b ; }
+void jit4 ( int v ) { memcpy(jitCode + jitLen, &v, 4) ; jitLen += 4 ; }
+void jit8 ( long v ) { memcpy(jitCode + jitLen, &v, 8) ; jitLen += 8 ; }
+
+/* op [rbx+4*r] with a 32-bit register */
+void jitReg ( int op, int modreg, int r )
+{ if ( op > 0xff ) jitB(op >> 8) ;
+  jitB(op & 0xff) ;
+  jitB(0x43 | (modreg << 3)) ;
+  jitB(4 * r) ;
+} /* jitReg */
+
+/* op r15d, imm32 */
+void jitTypes ( int modreg, int imm )
+{ jitB(0x41) ; jitB((modreg == 0) ? 0xf7 : 0x81) ;
+  jitB(0xc7 | (modreg << 3)) ; jit4(imm) ;
+} /* jitTypes */
+
+/* jcc or jmp (cc < 0) with a rel32 to be fixed up */
+void jitJump ( int cc, int loc, JITFIXKIND kind )
+{ if ( cc < 0 ) jitB(0xe9) ;
+  else { jitB(0x0f) ; jitB(0x80 | cc) ; }
+  jitFix[nJitFix].at = jitLen ;
+  jitFix[nJitFix].loc = loc ;
+  jitFix[nJitFix].kind = kind ;
+  nJitFix++ ;
+  jit4(0) ;
+  if ( kind == fixSLOW ) jitSlowStub[loc] = 0 ;
+} /* jitJump */
+
+/* jump to the exit stub of loc if any register in mask is FLOAT */
+void jitGuardInt ( int mask, int loc )
+{ jitTypes(0, mask) ;                        /* test r15d, mask */
+  jitJump(0x5, loc, fixSLOW) ;               /* jnz */
+} /* jitGuardInt */
+
+/* set the type bit of reg(r) */
+void jitSetType ( int r, int isFloat )
+{ if ( isFloat ) jitTypes(1, 1 << r) ;       /* or r15d, bit */
+  else jitTypes(4, ~(1 << r)) ;              /* and r15d, ~bit */
+} /* jitSetType */
+
+/* type bit of reg(r) = CF, as left by a bt */
+void jitTypeFromCF ( int r )
+{ jitB(0x19) ; jitB(0xc9) ;                  /* sbb ecx, ecx */
+  jitB(0x81) ; jitB(0xe1) ; jit4(1 << r) ;   /* and ecx, bit */
+  jitSetType(r, FALSE) ;
+  jitB(0x41) ; jitB(0x09) ; jitB(0xcf) ;     /* or r15d, ecx */
+} /* jitTypeFromCF */
+
+/* rdx = dFloat */
+void jitLoadDFloat (void)
+{ jitB(0x48) ; jitB(0x8b) ; jitB(0x55) ; jitB(offsetof(JITCONTEXT, dFloat)) ;
+} /* jitLoadDFloat */
+
+/* rdx = &dFloat[eax >> 5] */
+void jitDFloatWord (void)
+{ jitLoadDFloat() ;
+  jitB(0x89) ; jitB(0xc1) ;                  /* mov ecx, eax */
+  jitB(0xc1) ; jitB(0xe9) ; jitB(5) ;        /* shr ecx, 5 */
+  jitB(0x48) ; jitB(0x8d) ; jitB(0x14) ; jitB(0x8a) ; /* lea rdx, [rdx+rcx*4] */
+} /* jitDFloatWord */
+
+/* regFloat = r15d, or r15d = regFloat */
+void jitSyncTypes ( int store )
+{ jitB(0x48) ; jitB(0xb8) ; jit8((long)&regFloat) ;  /* mov rax, &regFloat */
+  jitB(0x44) ; jitB(store ? 0x89 : 0x8b) ; jitB(0x38) ;
+} /* jitSyncTypes */
+
+/* eax = k + reg(s), leaving for the stub unless it is a dMem
+ * address; no checks when the verifier proved it, and no bound
+ * check with a guarded dVal, where jitFault catches the access
+ */
+void jitAddress ( int s, int k, int loc, int proven )
+{ if ( ! proven ) jitGuardInt(1 << s, loc) ;
+  jitReg(0x8b, 0, s) ;                       /* mov eax, reg(s) */
+  jitB(0x05) ; jit4(k) ;                     /* add eax, k */
+  if ( proven || (dGuardEnd != NULL) ) return ;
+  jitB(0x3d) ; jit4(daddrSize) ;             /* cmp eax, daddrSize */
+  jitJump(0x3, loc, fixSLOW) ;               /* jae */
+} /* jitAddress */
+
+/* reg(r) = eax, INT */
+void jitSetInt ( int r )
+{ jitReg(0x89, 0, r) ;
+  jitSetType(r, FALSE) ;
+} /* jitSetInt */
+
+/* call f(r), with regFloat up to date across the call */
+void jitCall ( void (*f)(int), int r )
+{ jitSyncTypes(TRUE) ;
+  jitB(0xbf) ; jit4(r) ;                     /* mov edi, r */
+  jitB(0x48) ; jitB(0xb8) ; jit8((long)f) ;  /* mov rax, f */
+  jitB(0xff) ; jitB(0xd0) ;                  /* call rax */
+  jitSyncTypes(FALSE) ;
+} /* jitCall */
+
+void jitIn ( int r )
+{ NUM v ;
+  if ( readIn(&v) ) setReg(r, v) ;
+} /* jitIn */
+
+void jitOut ( int r ) { writeOut(getReg(r)) ; }
+
+/********************************************/
+/* Function compileJIT translates dCode and */
+/* returns FALSE if no executable memory    */
+/* could be had                             */
+/********************************************/
+int compileJIT (void)
+{ int loc, b, end, exitAt, i, rel ;
+  DINSTRUCTION * dp ;
+  int dop ;
+  if ( jitCode == NULL )
+  { if ( JIT_CODE_SIZE > JIT_CODE_MAX ) return FALSE ;
+    jitCode = (unsigned char *) mmap(NULL, JIT_CODE_SIZE,
+                PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0) ;
+    if ( jitCode == (unsigned char *) MAP_FAILED )
+    { jitCode = NULL ;
+      return FALSE ;
+    }
+    jitEntry = (void **) mapZero((size_t) iaddrSize * sizeof(void *)) ;
+    jitLabel = (int *) mapZero((size_t) iaddrSize * sizeof(int)) ;
+    jitSlowStub = (int *) mapZero((size_t) iaddrSize * sizeof(int)) ;
+    jitFix = (JITFIXUP *) mapZero((size_t) iaddrSize * 4 * sizeof(JITFIXUP)) ;
+  }
+  else mprotect(jitCode, JIT_CODE_SIZE, PROT_READ | PROT_WRITE) ;
+  jitLen = 0 ;
+  nJitFix = 0 ;
+
+  /* exit: store the types, n and pc (ecx), restore and return */
+  exitAt = jitLen ;
+  jitSyncTypes(TRUE) ;
+  jitB(0x4c) ; jitB(0x89) ; jitB(0x6d) ; jitB(offsetof(JITCONTEXT, n)) ;
+  jitB(0x89) ; jitB(0x4d) ; jitB(offsetof(JITCONTEXT, pc)) ;
+  jitB(0x48) ; jitB(0x83) ; jitB(0xc4) ; jitB(8) ;     /* add rsp, 8 */
+  jitB(0x41) ; jitB(0x5f) ; jitB(0x41) ; jitB(0x5e) ;  /* pop r15, r14 */
+  jitB(0x41) ; jitB(0x5d) ; jitB(0x41) ; jitB(0x5c) ;  /* pop r13, r12 */
+  jitB(0x5d) ; jitB(0x5b) ; jitB(0xc3) ;               /* pop rbp, rbx; ret */
+
+  /* entry: void f(JITCONTEXT * rdi) */
+  jitEntryAt = jitLen ;
+  jitB(0x53) ; jitB(0x55) ;                            /* push rbx, rbp */
+  jitB(0x41) ; jitB(0x54) ; jitB(0x41) ; jitB(0x55) ;  /* push r12, r13 */
+  jitB(0x41) ; jitB(0x56) ; jitB(0x41) ; jitB(0x57) ;  /* push r14, r15 */
+  jitB(0x48) ; jitB(0x83) ; jitB(0xec) ; jitB(8) ;     /* sub rsp, 8 */
+  jitB(0x48) ; jitB(0x89) ; jitB(0xfd) ;               /* mov rbp, rdi */
+  jitB(0x48) ; jitB(0x8b) ; jitB(0x5d) ; jitB(offsetof(JITCONTEXT, reg)) ;
+  jitB(0x4c) ; jitB(0x8b) ; jitB(0x65) ; jitB(offsetof(JITCONTEXT, dMem)) ;
+  jitB(0x4c) ; jitB(0x8b) ; jitB(0x6d) ; jitB(offsetof(JITCONTEXT, n)) ;
+  jitB(0x4c) ; jitB(0x8b) ; jitB(0x75) ; jitB(offsetof(JITCONTEXT, entry)) ;
+  jitSyncTypes(FALSE) ;
+  jitB(0x8b) ; jitB(0x45) ; jitB(offsetof(JITCONTEXT, pc)) ;
+  jitB(0x41) ; jitB(0xff) ; jitB(0x24) ; jitB(0xc6) ;  /* jmp [r14+rax*8] */
+
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+  { dp = &dCode[loc] ;
+    dop = dp->dop ;
+    if ( (dop >= dopCMPLT) && (dop <= dopCMPNE) ) dop = dopSUB ;
+    else if ( (dop == dopPUSHLD) || (dop == dopPUSHLDC) ) dop = dopST ;
+    jitSlowStub[loc] = -1 ;
+    jitLabel[loc] = jitLen ;
+    b = blockOf[loc] ;
+    if ( blocks[b].start == loc )
+    { jitB(0x49) ; jitB(0x81) ; jitB(0xc5) ; jit4(blocks[b].len) ; /* add r13 */
+    }
+    switch ( dop )
+    { case dopIN :   /* stepTM repeats an IN that found no input */
+        jitCall(jitIn, dp->r) ;
+        jitB(0x48) ; jitB(0xb8) ; jit8((long)&inputEnded) ; /* mov rax, &inputEnded */
+        jitB(0x83) ; jitB(0x38) ; jitB(0) ;                 /* cmp dword [rax], 0 */
+        jitJump(0x5, loc, fixSLOW) ;                        /* jnz */
+        break;
+      case dopOUT : jitCall(jitOut, dp->r) ; break;
+      case dopADD : case dopSUB : case dopMUL : case dopXOR : case dopDIV :
+        jitGuardInt((1 << dp->s) | (1 << dp->t), loc) ;
+        if ( dop == dopDIV )
+        { jitReg(0x8b, 1, dp->t) ;               /* mov ecx, reg(t) */
+          jitB(0xf7) ; jitB(0xc1) ; jit4(0x7fffffff) ; /* test ecx, ~sign */
+          jitJump(0x4, loc, fixSLOW) ;            /* jz */
+          jitReg(0x8b, 0, dp->s) ;               /* mov eax, reg(s) */
+          jitB(0x99) ; jitB(0xf7) ; jitB(0xf9) ;  /* cdq; idiv ecx */
         }
-      }
+        else
+        { jitReg(0x8b, 0, dp->s) ;               /* mov eax, reg(s) */
+          switch ( dop )
+          { case dopADD : jitReg(0x03, 0, dp->t) ; break;
+            case dopSUB : jitReg(0x2b, 0, dp->t) ; break;
+            case dopXOR : jitReg(0x33, 0, dp->t) ; break;
+            default :     jitReg(0x0faf, 0, dp->t) ; break;
+          }
+        }
+        jitSetInt(dp->r) ;
+        break;
+      case dopLD : case dopLDU :
+        jitAddress(dp->s, dp->k.valint, loc, dop == dopLDU) ;
+        jitB(0x41) ; jitB(0x8b) ; jitB(0x0c) ; jitB(0x84) ; /* mov ecx, [r12+rax*4] */
+        jitReg(0x89, 1, dp->r) ;                            /* mov reg(r), ecx */
+        jitDFloatWord() ;
+        jitB(0x8b) ; jitB(0x12) ;                           /* mov edx, [rdx] */
+        jitB(0x0f) ; jitB(0xa3) ; jitB(0xc2) ;              /* bt edx, eax */
+        jitTypeFromCF(dp->r) ;
+        break;
+      case dopST : case dopSTU :
+        jitAddress(dp->s, dp->k.valint, loc, dop == dopSTU) ;
+        jitReg(0x8b, 1, dp->r) ;                            /* mov ecx, reg(r) */
+        jitB(0x41) ; jitB(0x89) ; jitB(0x0c) ; jitB(0x84) ; /* mov [r12+rax*4], ecx */
+        jitDFloatWord() ;
+        jitB(0x8b) ; jitB(0x32) ;                           /* mov esi, [rdx] */
+        jitB(0x0f) ; jitB(0xb3) ; jitB(0xc6) ;              /* btr esi, eax */
+        jitTypes(0, 1 << dp->r) ;                           /* test r15d, bit */
+        jitB(0x74) ; jitB(3) ;                              /* jz +3 */
+        jitB(0x0f) ; jitB(0xab) ; jitB(0xc6) ;              /* bts esi, eax */
+        jitB(0x89) ; jitB(0x32) ;                           /* mov [rdx], esi */
+        break;
+      case dopLDK :
+        jitB(0x41) ; jitB(0x8b) ; jitB(0x8c) ; jitB(0x24) ; /* mov ecx, [r12+4k] */
+        jit4(4 * dp->k.valint) ;
+        jitReg(0x89, 1, dp->r) ;
+        jitLoadDFloat() ;
+        jitB(0x0f) ; jitB(0xba) ; jitB(0xa2) ;              /* bt [rdx+d], i */
+        jit4(4 * (dp->k.valint >> 5)) ; jitB(dp->k.valint & 31) ;
+        jitTypeFromCF(dp->r) ;
+        break;
+      case dopSTK :
+        jitReg(0x8b, 1, dp->r) ;
+        jitB(0x41) ; jitB(0x89) ; jitB(0x8c) ; jitB(0x24) ; /* mov [r12+4k], ecx */
+        jit4(4 * dp->k.valint) ;
+        jitLoadDFloat() ;
+        jitB(0x0f) ; jitB(0xba) ; jitB(0xb2) ;              /* btr [rdx+d], i */
+        jit4(4 * (dp->k.valint >> 5)) ; jitB(dp->k.valint & 31) ;
+        jitTypes(0, 1 << dp->r) ;
+        jitB(0x74) ; jitB(8) ;                              /* jz +8 */
+        jitB(0x0f) ; jitB(0xba) ; jitB(0xaa) ;              /* bts [rdx+d], i */
+        jit4(4 * (dp->k.valint >> 5)) ; jitB(dp->k.valint & 31) ;
+        break;
+      case dopLDA :
+        jitGuardInt(1 << dp->s, loc) ;
+        jitReg(0x8b, 0, dp->s) ;
+        jitB(0x05) ; jit4(dp->k.valint) ;
+        jitSetInt(dp->r) ;
+        break;
+      case dopMULI :
+        jitGuardInt(1 << dp->s, loc) ;
+        jitReg(0x8b, 0, dp->s) ;
+        jitB(0x69) ; jitB(0xc0) ; jit4(dp->k.valint) ; /* imul eax, eax, k */
+        jitSetInt(dp->r) ;
+        break;
+      case dopLDCI :
+      case dopLDCF :
+        jitReg(0xc7, 0, dp->r) ; jit4(dp->k.valint) ;
+        jitSetType(dp->r, dop == dopLDCF) ;
+        break;
+      case dopJMP :
+        jitJump(-1, dp->k.valint, fixLABEL) ;
+        break;
+      case dopJLT : case dopJLE : case dopJGT :
+      case dopJGE : case dopJEQ : case dopJNE :
+        { static const int cc[] = { 0xc, 0xe, 0xf, 0xd, 0x4, 0x5 } ;
+          jitReg(0x83, 7, dp->r) ; jitB(0) ;      /* cmp dword reg(r), 0 */
+          jitJump(cc[dop - dopJLT], dp->k.valint, fixLABEL) ;
+        }
+        break;
+      default :   /* HALT, faults, dynamic jumps, rare forms */
+        jitJump(-1, loc, fixSLOW) ;
+        break;
+    }
+  }
+  /* falling off the end of iMem */
+  jitB(0xb9) ; jit4(iaddrSize) ;               /* mov ecx, iaddrSize */
+  jitB(0xe9) ; jit4(exitAt - (jitLen + 4)) ;
+
+  /* exit stubs: uncount the rest of the block, pc = loc */
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+    if ( jitSlowStub[loc] >= 0 )
+    { b = blockOf[loc] ;
+      end = blocks[b].start + blocks[b].len ;
+      jitSlowStub[loc] = jitLen ;
+      jitB(0x49) ; jitB(0x81) ; jitB(0xed) ; jit4(end - loc) ; /* sub r13 */
+      jitB(0xb9) ; jit4(loc) ;                                 /* mov ecx, loc */
+      jitB(0xe9) ; jit4(exitAt - (jitLen + 4)) ;
+    }
+
+  /* side entries into the middle of a block */
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+  { b = blockOf[loc] ;
+    if ( blocks[b].start == loc )
+      jitEntry[loc] = jitCode + jitLabel[loc] ;
+    else
+    { end = blocks[b].start + blocks[b].len ;
+      jitEntry[loc] = jitCode + jitLen ;
+      jitB(0x49) ; jitB(0x81) ; jitB(0xc5) ; jit4(end - loc) ; /* add r13 */
+      jitB(0xe9) ; jit4(jitLabel[loc] - (jitLen + 4)) ;
+    }
+  }
+
+  for (i = 0 ; i < nJitFix ; i++)
+  { loc = jitFix[i].loc ;
+    rel = ( (jitFix[i].kind == fixLABEL) ? jitLabel[loc] : jitSlowStub[loc] )
+          - (jitFix[i].at + 4) ;
+    memcpy(jitCode + jitFix[i].at, &rel, 4) ;
+  }
+  mprotect(jitCode, JIT_CODE_SIZE, PROT_READ | PROT_EXEC) ;
+  return TRUE ;
+} /* compileJIT */
+
+/********************************************/
+/* Procedure jitFault handles SIGSEGV. A    */
+/* native LD or ST that hits the guard      */
+/* after dVal resumes at the exit stub of   */
+/* its location, before anything has been   */
+/* stored, so stepTM runs it again and      */
+/* reports srDMEM_ERR. Any other fault gets */
+/* the default action                       */
+/********************************************/
+void jitFault ( int sig, siginfo_t * info, void * context )
+{ ucontext_t * uc = (ucontext_t *) context ;
+  unsigned char * rip = (unsigned char *) uc->uc_mcontext.gregs[REG_RIP] ;
+  char * addr = (char *) info->si_addr ;
+  int lo = 0, hi = iaddrSize - 1, mid, off ;
+  if ( (dGuardEnd != NULL) && (addr >= (char *) (dVal + daddrSize))
+       && (addr < dGuardEnd) && (rip >= jitCode) && (rip < jitCode + jitLen) )
+  { off = rip - jitCode ;
+    while ( lo < hi )   /* last location whose code starts at or before off */
+    { mid = (lo + hi + 1) / 2 ;
+      if ( jitLabel[mid] <= off ) lo = mid ; else hi = mid - 1 ;
+    }
+    if ( (jitLabel[lo] <= off) && (jitSlowStub[lo] >= 0) )
+    { uc->uc_mcontext.gregs[REG_RIP] = (greg_t) (jitCode + jitSlowStub[lo]) ;
+      return ;
+    }
+  }
+  signal(sig, SIG_DFL) ;
+} /* jitFault */
+
+/********************************************/
+/* Function runJIT is runTM for the JIT:    */
+/* whenever native code exits, at a float   */
+/* operand or anything else it does not     */
+/* compile, the interpreter runs from the   */
+/* instruction it stopped at to the next    */
+/* jump taken, and reports any fault; then  */
+/* native code goes on from there. After a  */
+/* native run of fewer than JIT_SHORT       */
+/* instructions, as in a float loop, the    */
+/* interpreter goes on for JIT_BACKOFF      */
+/********************************************/
+STEPRESULT runJIT ( long * icount )
+{ JITCONTEXT ctx ;
+  STEPRESULT result ;
+  struct sigaction sa, saved ;
+  int pc ;
+  long n, before ;
+  if ( ! jitCompiled )
+  { if ( ! compileJIT () ) return runTM (icount) ;
+    jitCompiled = TRUE ;
+  }
+  memset(&sa, 0, sizeof(sa)) ;
+  sa.sa_sigaction = jitFault ;
+  sa.sa_flags = SA_SIGINFO ;
+  sigemptyset(&sa.sa_mask) ;
+  sigaction(SIGSEGV, &sa, &saved) ;
+  ctx.reg = regVal ;
+  ctx.dMem = dVal ;
+  ctx.dFloat = dFloat ;
+  ctx.entry = jitEntry ;
+  ctx.n = 0 ;
+  for (;;)
+  { pc = regVal[PC_REG].valint ;
+    if ( (pc < 0) || (pc >= iaddrSize) )
+    { ctx.n++ ;
+      result = srIMEM_ERR ;
       break;
+    }
+    ctx.pc = pc ;
+    before = ctx.n ;
+    ((void (*)(JITCONTEXT *)) (jitCode + jitEntryAt)) (&ctx) ;
+    regVal[PC_REG].valint = ctx.pc ; regFloat &= ~(1u << PC_REG) ;
+    result = runFor (&n, (ctx.n - before < JIT_SHORT) ? JIT_BACKOFF : 1) ;
+    ctx.n += n ;
+    if ( result != srOKAY ) break;
+  }
+  sigaction(SIGSEGV, &saved, NULL) ;
+  *icount = ctx.n ;
+  return result ;
+} /* runJIT */
 
-    case 'd' :
-    /***********************************/
-      printcnt = 1 ;
-      if ( getNum  ())
-      { dloc = num ;
-        if ( getNum ()) printcnt = num ;
+#else
+
+STEPRESULT runJIT ( long * icount )
+{ return runTM (icount) ;
+} /* runJIT */
+
+#endif
+
+/********************************************/
+/* SPMD lanes: runLanes runs one program    */
+/* on up to MAXLANES machines at once, in   */
+/* lockstep while they are at the same pc.  */
+/* Registers and dMem are held lane by      */
+/* lane, mem(a) of every lane side by side, */
+/* so that int ADD, SUB, MUL, XOR, LD and   */
+/* ST with the same address in every lane   */
+/* are vector operations, AVX2 where the    */
+/* processor has it. Lanes that branch      */
+/* apart wait at their own pcs, and the     */
+/* lowest pc always runs next, so they meet */
+/* again where the paths join. A lane that  */
+/* meets float arithmetic, or nears its     */
+/* budget, leaves the lanes and runs on     */
+/* alone with runFor, as a batch of one     */
+/********************************************/
+#if defined(__GNUC__)
+
+typedef int LANES __attribute__ ((vector_size (32))) ;   /* 8 lanes */
+
+#if defined(__x86_64__) && defined(__linux__)
+#define LANECLONES  __attribute__ ((target_clones ("avx2", "default")))
+#else
+#define LANECLONES
+#endif
+
+/* lane l of a vector array */
+#define LANE(v, l)    ( (v)[(l) >> 3][(l) & 7] )
+
+/* every lane of b, in turn, as l */
+#define EACHLANE(b)   for (bits = (b) ; (bits != 0) && ((l = __builtin_ctz(bits)), TRUE) ; bits &= bits - 1)
+
+/* d = x in the running lanes */
+#define BLEND(d, x)                                                 \
+  { for (g = 0 ; g < vecs ; g++)                                    \
+      d[g] = (x[g] & mv[g]) | (d[g] & ~mv[g]) ;                     \
+  }
+
+/* mv from run */
+#define SETMASK()                                                   \
+  { for (i = 0 ; i < lanes ; i++)                                   \
+      LANE(mv, i) = ((run >> i) & 1u) ? -1 : 0 ;                    \
+  }
+
+/* lane l stops with res, after the current instruction unless
+ * it is not counted
+ */
+#define STOPLANE(l, res, counted)                                   \
+  { result[l] = (res) ;                                             \
+    count[l] += steps - since[l] - ((counted) ? 0 : 1) ;            \
+    run &= ~(1u << (l)) ;                                           \
+    stopped = TRUE ;                                                \
+  }
+
+/* lane l leaves the lanes before the instruction at cur, after
+ * executing steps-since[l] of them, and runs on alone
+ */
+#define ALONE(l)                                                    \
+  { count[l] += steps - since[l] ;                                  \
+    if ( out != NULL ) { outHook = out ; outUser = user[l] ; }      \
+    result[l] = laneAlone(l, lanes, cur, reg, rf, mem, mf, next[l], \
+                          text[l] + len[l],                         \
+                          (budget > 0) ? budget - count[l] : 0,     \
+                          &icount) ;                                \
+    count[l] += icount ;                                            \
+    run &= ~(1u << (l)) ;                                           \
+  }
+
+/* the running lanes go on at np[] */
+#define GOTO()                                                      \
+  { int _f = __builtin_ctz(run), _same = TRUE ;                     \
+    EACHLANE(run) if ( np[l] != np[_f] ) _same = FALSE ;            \
+    if ( _same ) cur = np[_f] ;                                     \
+    else                                                            \
+    { EACHLANE(run)                                                 \
+      { pc[l] = np[l] ;                                             \
+        count[l] += steps - since[l] ;                              \
+      }                                                             \
+      wait |= run ;                                                 \
+      run = 0 ;                                                     \
+    }                                                               \
+  }
+
+/* reg(r) = reg(s) op reg(t) in the running lanes, as a
+ * vector when no lane has a float operand
+ */
+#define VECOP(op)                                                   \
+  { if ( ((rf[s] | rf[t]) & run) != 0 ) break ;                     \
+    for (g = 0 ; g < vecs ; g++) x[g] = reg[s][g] op reg[t][g] ;    \
+    BLEND(reg[r], x) ;                                              \
+    rf[r] &= ~run ;                                                 \
+    NEXTLANES(r) ;                                                  \
+  }
+
+/* after an instruction that wrote reg(r): on to the next one,
+ * or to reg(7) of each lane if r is the pc
+ */
+#define NEXTLANES(r)                                                \
+  { if ( run == 0 ) continue ;                                      \
+    if ( (r) != PC_REG ) { cur++ ; continue ; }                     \
+    EACHLANE(run) np[l] = LANE(reg[PC_REG], l) ;                    \
+    GOTO() ;                                                        \
+    continue ;                                                      \
+  }
+
+/* the address k+reg(s) of lane l, as stepTM computes it: an
+ * int, or a float if k or reg(s) is
+ */
+int laneAddress ( NUM k, int s, int isFloat, NUM * m )
+{ if ( (k.type == INT) && ! isFloat )
+  { m->attr.valint = k.attr.valint + s ;
+    m->type = INT ;
+  }
+  else
+  { WORD w ;
+    w.valint = s ;
+    m->attr.valfloat = (k.type == FLOAT) ? k.attr.valfloat : k.attr.valint ;
+    m->attr.valfloat += isFloat ? w.valfloat : s ;
+    m->type = FLOAT ;
+  }
+  return m->type == INT ;
+} /* laneAddress */
+
+/* Function laneAlone runs lane l, of lanes held side by
+ * side in reg, rf, mem and mf, on the bound machine: its
+ * registers and dMem are copied out, and it runs from at
+ * with runFor, reading IN from next up to end
+ */
+STEPRESULT laneAlone ( int l, int lanes, int at, LANES reg[][MAXLANES / 8],
+                       unsigned rf[], int * mem, unsigned * mf, char * next,
+                       char * end, long limit, long * icount )
+{ int i, a, w ;
+  clearMachine () ;
+  for (i = 0 ; i < NO_REGS ; i++)
+  { regVal[i].valint = LANE(reg[i], l) ;
+    regFloat |= ((rf[i] >> l) & 1u) << i ;
+  }
+  regVal[PC_REG].valint = at ;
+  regFloat &= ~(1u << PC_REG) ;
+  for (a = 0 ; a < daddrSize ; a++)
+  { w = mem[(size_t) a * lanes + l] ;
+    if ( (w != 0) || (a == 0) ) dVal[a].valint = w ;   /* untouched pages stay so */
+    dFloat[a >> 5] |= ((mf[a] >> l) & 1u) << (a & 31) ;
+  }
+  openText(next, end - next) ;
+  inputEnded = FALSE ;
+  return runFor(icount, limit) ;
+} /* laneAlone */
+
+LANECLONES
+void runLanes ( int n, char * text[], size_t len[], TMOUTHOOK out,
+                void * user[], STEPRESULT result[], long count[], long budget )
+{ LANES reg [NO_REGS][MAXLANES / 8], mv [MAXLANES / 8], x [MAXLANES / 8], y ;
+  unsigned rf [NO_REGS] ;     /* bit l: reg of lane l is FLOAT */
+  int * mem ;                 /* mem(a) of lane l at a*lanes+l */
+  unsigned * mf ;             /* bit l: mem(a) of lane l is FLOAT */
+  int pc [MAXLANES], np [MAXLANES] ;
+  long since [MAXLANES] ;     /* steps when the lane last began to run */
+  char * next [MAXLANES] ;    /* unread input of each lane */
+  unsigned run, wait, bits, taken, bad ;
+  int cur, nextWait, lanes, vecs, isize = iaddrSize, dsize = daddrSize ;
+  int l, g, i, r, s, t, a, stopped ;
+  long steps = 0, due = 0, used, icount ;
+  INSTRUCTION * ip ;
+  NUM v, m ;
+  char * savedNext = inNext, * savedEnd = inEnd ;
+  int savedAll = inAll, savedBatch = batchInput ;
+  TMINHOOK savedIn = inHook ;
+  TMOUTHOOK savedOut = outHook ;
+  void * savedUser = outUser ;
+
+  if ( n > MAXLANES ) n = MAXLANES ;
+  if ( n <= 0 ) return ;
+  inHook = NULL ;   /* lanes that run alone read text too */
+  lanes = (n <= 8) ? 8 : 16 ;
+  vecs = lanes / 8 ;
+  mem = (int *) mapZero((size_t) dsize * lanes * sizeof(int)) ;
+  mf = (unsigned *) mapZero((size_t) dsize * sizeof(unsigned)) ;
+  memset(reg, 0, sizeof(reg)) ;
+  memset(rf, 0, sizeof(rf)) ;
+  for (l = 0 ; l < n ; l++)
+  { mem[l] = dsize - 1 ;
+    next[l] = text[l] ;
+    count[l] = 0 ;
+    since[l] = 0 ;
+  }
+  run = (1u << n) - 1 ;
+  wait = 0 ;
+  cur = nextWait = 0 ;
+  SETMASK() ;
+  for (;;)
+  { /* the lowest pc runs: park the running lanes and take
+     * every lane at the lowest
+     */
+    if ( (wait != 0) && ((run == 0) || (cur >= nextWait)) )
+    { EACHLANE(run)
+      { pc[l] = cur ;
+        count[l] += steps - since[l] ;
       }
-      if ( ! atEOL ())
-        printf("Data locations?\n");
-      else
-      { while ((dloc >= 0) && (dloc < DADDR_SIZE)
-                  && (printcnt > 0))
-        { printf("%5d: ",dloc);
-          if (dMem[dloc].type == INT) printf("%5d\n", dMem[dloc].attr.valint);
-          else printf("%.4f\n", dMem[dloc].attr.valfloat);
-          dloc++;
-          printcnt--;
+      wait |= run ;
+      cur = pc[__builtin_ctz(wait)] ;
+      EACHLANE(wait) if ( pc[l] < cur ) cur = pc[l] ;
+      run = 0 ;
+      nextWait = cur ;
+      EACHLANE(wait)
+        if ( pc[l] == cur )
+        { run |= 1u << l ;
+          since[l] = steps ;
         }
+        else if ( (nextWait == cur) || (pc[l] < nextWait) ) nextWait = pc[l] ;
+      wait &= ~run ;
+      SETMASK() ;
+      due = steps ;
+    }
+    if ( run == 0 ) break ;
+    /* lanes one instruction short of the budget run on alone,
+     * to stop at the jump where runFor would
+     */
+    if ( (budget > 0) && (steps >= due) )
+    { due = steps + budget ;
+      EACHLANE(run)
+      { used = count[l] + steps - since[l] ;
+        if ( used >= budget - 1 ) ALONE(l)
+        else if ( steps + budget - 1 - used < due ) due = steps + budget - 1 - used ;
       }
-      break;
+      SETMASK() ;
+      if ( run == 0 ) continue ;
+    }
+    steps++ ;
+    stopped = FALSE ;
+    if ( (cur < 0) || (cur >= isize) )
+    { EACHLANE(run) STOPLANE(l, srIMEM_ERR, TRUE) ;
+      continue ;
+    }
+    ip = &iMem[cur] ;
+    r = ip->iarg1 ;
+    s = ip->iarg3 ;
+    t = ip->iarg3 ;
+    if ( ip->iop <= opRRLim ) s = ip->iarg2.attr.valint ;
+    if ( (r == PC_REG) || (s == PC_REG) || (t == PC_REG) )
+    { /* reg(7) reads as the next pc */
+      for (g = 0 ; g < vecs ; g++) x[g] = (LANES) {} + (cur + 1) ;
+      BLEND(reg[PC_REG], x) ;
+      rf[PC_REG] &= ~run ;
+    }
+    switch ( ip->iop )
+    { case opHALT :
+        flushOut () ;
+        EACHLANE(run)
+        { if ( msgOut != NULL )
+            fprintf(msgOut, "HALT: %1d,%1d,%1d\n", r, s, t) ;
+          STOPLANE(l, srHALT, TRUE) ;
+        }
+        continue ;
 
-    case 'c' :
-    /***********************************/
-      iloc = 0;
-      dloc = 0;
-      stepcnt = 0;
-      for (regNo = 0;  regNo < NO_REGS ; regNo++)
-      {
-            reg[regNo].attr.valfloat = 0 ;
-            reg[regNo].type = INT ;
-      }
-      dMem[0].attr.valint = DADDR_SIZE - 1 ; dMem[0].type = INT ;
-      for (loc = 1 ; loc < DADDR_SIZE ; loc++)
-      {
-            dMem[loc].attr.valfloat = 0 ;
-            dMem[loc].type = INT ;
-      }
-      break;
+      case opIN :
+        EACHLANE(run)
+        { inNext = next[l] ;
+          inEnd = text[l] + len[l] ;
+          inAll = TRUE ;
+          if ( readBatch(&v) )
+          { LANE(reg[r], l) = v.attr.valint ;
+            rf[r] = (rf[r] & ~(1u << l)) | ((unsigned) (v.type == FLOAT) << l) ;
+          }
+          else STOPLANE(l, srNO_INPUT, FALSE) ;
+          next[l] = inNext ;
+        }
+        inNext = savedNext ;
+        inEnd = savedEnd ;
+        inAll = savedAll ;
+        if ( stopped ) SETMASK() ;
+        NEXTLANES(r) ;
 
-    case 'q' : return FALSE;  /* break; */
-
-    default : printf("Command %c unknown.\n", cmd); break;
-  }  /* case */
-  stepResult = srOKAY;
-  if ( stepcnt > 0 )
-  { if ( cmd == 'g' )
-    { stepcnt = 0;
-      while (stepResult == srOKAY)
-      { iloc = reg[PC_REG].attr.valint ;
-        if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
-        stepcnt++;
-      }
-      if ( icountflag )
-        printf("Number of instructions executed = %d\n",stepcnt);
+      case opOUT :
+        EACHLANE(run)
+        { v.attr.valint = LANE(reg[r], l) ;
+          v.type = ((rf[r] >> l) & 1u) ? FLOAT : INT ;
+          if ( out != NULL ) out(user[l], v) ; else writeOut(v) ;
+        }
+        cur++ ;
+        continue ;
+
+      case opADD : VECOP(+) ;
+      case opSUB : VECOP(-) ;
+      case opMUL : VECOP(*) ;
+      case opXOR : VECOP(^) ;
+
+      case opDIV :
+        if ( ((rf[s] | rf[t]) & run) != 0 ) break ;
+        EACHLANE(run)
+        { WORD d ;
+          d.valint = LANE(reg[t], l) ;
+          if ( d.valfloat == 0 ) STOPLANE(l, srZERODIVIDE, TRUE)
+          else LANE(reg[r], l) = LANE(reg[s], l) / d.valint ;
+        }
+        rf[r] &= ~run ;
+        if ( stopped ) SETMASK() ;
+        NEXTLANES(r) ;
+
+      case opLD :
+      case opST :
+        /* float addresses fault, then the rest are bounds checked */
+        if ( (ip->iarg2.type == FLOAT) || ((rf[s] & run) != 0) )
+        { EACHLANE(run)
+            if ( (ip->iarg2.type == FLOAT) || ((rf[s] >> l) & 1u) )
+              STOPLANE(l, srMEM_FLOAT, TRUE) ;
+          SETMASK() ;
+          if ( run == 0 ) continue ;
+        }
+        for (g = 0 ; g < vecs ; g++) x[g] = reg[s][g] + ip->iarg2.attr.valint ;
+        a = LANE(x, __builtin_ctz(run)) ;
+        for (g = 0, y = (LANES) {} ; g < vecs ; g++) y |= (x[g] ^ a) & mv[g] ;
+        for (g = 1 ; g < 8 ; g++) y[0] |= y[g] ;
+        if ( y[0] != 0 ) a = -1 ;
+        if ( ! addrProven[cur] && ((unsigned) a >= (unsigned) dsize) )
+        { bad = 0 ;
+          EACHLANE(run)
+            if ( (unsigned) LANE(x, l) >= (unsigned) dsize ) bad |= 1u << l ;
+          if ( bad != 0 )
+          { EACHLANE(bad) STOPLANE(l, srDMEM_ERR, TRUE) ;
+            SETMASK() ;
+            if ( run == 0 ) continue ;
+            a = -1 ;
+          }
+        }
+        if ( a >= 0 )   /* the same in every lane: a vector */
+        { LANES * p = (LANES *) (mem + (size_t) a * lanes) ;
+          if ( ip->iop == opLD )
+          { for (g = 0 ; g < vecs ; g++) x[g] = p[g] ;
+            BLEND(reg[r], x) ;
+            rf[r] = (rf[r] & ~run) | (mf[a] & run) ;
+          }
+          else
+          { for (g = 0 ; g < vecs ; g++)
+              p[g] = (reg[r][g] & mv[g]) | (p[g] & ~mv[g]) ;
+            mf[a] = (mf[a] & ~run) | (rf[r] & run) ;
+          }
+        }
+        else if ( ip->iop == opLD )
+        { EACHLANE(run)
+          { a = LANE(x, l) ;
+            LANE(reg[r], l) = mem[(size_t) a * lanes + l] ;
+            rf[r] = (rf[r] & ~(1u << l)) | (mf[a] & (1u << l)) ;
+          }
+        }
+        else
+        { EACHLANE(run)
+          { a = LANE(x, l) ;
+            mem[(size_t) a * lanes + l] = LANE(reg[r], l) ;
+            mf[a] = (mf[a] & ~(1u << l)) | (rf[r] & (1u << l)) ;
+          }
+        }
+        if ( ip->iop == opST ) { cur++ ; continue ; }
+        NEXTLANES(r) ;
+
+      case opLDA :
+      case opADDI :
+        if ( (ip->iarg2.type == INT) && ((rf[s] & run) == 0) )
+        { for (g = 0 ; g < vecs ; g++) x[g] = reg[s][g] + ip->iarg2.attr.valint ;
+          BLEND(reg[r], x) ;
+          rf[r] &= ~run ;
+          NEXTLANES(r) ;
+        }
+        EACHLANE(run)
+        { laneAddress(ip->iarg2, LANE(reg[s], l), (rf[s] >> l) & 1u, &m) ;
+          LANE(reg[r], l) = m.attr.valint ;
+          rf[r] = (rf[r] & ~(1u << l)) | ((unsigned) (m.type == FLOAT) << l) ;
+        }
+        NEXTLANES(r) ;
+
+      case opMULI :
+        if ( (ip->iarg2.type != INT) || ((rf[s] & run) != 0) ) break ;
+        for (g = 0 ; g < vecs ; g++) x[g] = reg[s][g] * ip->iarg2.attr.valint ;
+        BLEND(reg[r], x) ;
+        rf[r] &= ~run ;
+        NEXTLANES(r) ;
+
+      case opLDC :
+        for (g = 0 ; g < vecs ; g++) x[g] = (LANES) {} + ip->iarg2.attr.valint ;
+        BLEND(reg[r], x) ;
+        rf[r] = (ip->iarg2.type == FLOAT) ? (rf[r] | run) : (rf[r] & ~run) ;
+        NEXTLANES(r) ;
+
+      case opJLT :
+      case opJLE :
+      case opJGT :
+      case opJGE :
+      case opJEQ :
+      case opJNE :
+        for (g = 0 ; g < vecs ; g++)
+          switch ( ip->iop )
+          { case opJLT : x[g] = reg[r][g] <  0 ; break ;
+            case opJLE : x[g] = reg[r][g] <= 0 ; break ;
+            case opJGT : x[g] = reg[r][g] >  0 ; break ;
+            case opJGE : x[g] = reg[r][g] >= 0 ; break ;
+            case opJEQ : x[g] = reg[r][g] == 0 ; break ;
+            default :    x[g] = reg[r][g] != 0 ; break ;
+          }
+        for (i = 0, taken = 0 ; i < lanes ; i++) taken |= (LANE(x, i) & 1u) << i ;
+        taken &= run ;
+        if ( taken == 0 ) { cur++ ; continue ; }
+        if ( (taken == run) && (s == PC_REG) && (ip->iarg2.type == INT) )
+        { cur += 1 + ip->iarg2.attr.valint ;
+          continue ;
+        }
+        EACHLANE(run)
+          if ( (taken >> l) & 1u )
+          { laneAddress(ip->iarg2, LANE(reg[s], l), (rf[s] >> l) & 1u, &m) ;
+            np[l] = m.attr.valint ;
+          }
+          else np[l] = cur + 1 ;
+        GOTO() ;
+        continue ;
+
+      default :
+        break ;
     }
-    else
-    { while ((stepcnt > 0) && (stepResult == srOKAY))
-      { iloc = reg[PC_REG].attr.valint ;
-        if ( traceflag ) writeInstruction( iloc ) ;
-        stepResult = stepTM ();
-        stepcnt-- ;
-      }
+    /* float arithmetic: the running lanes go on alone from the
+     * instruction, which is not yet executed
+     */
+    steps-- ;
+    EACHLANE(run) ALONE(l) ;
+  }
+  unmapZero(mem, (size_t) dsize * lanes * sizeof(int)) ;
+  unmapZero(mf, (size_t) dsize * sizeof(unsigned)) ;
+  inNext = savedNext ;
+  inEnd = savedEnd ;
+  inAll = savedAll ;
+  batchInput = savedBatch ;
+  inHook = savedIn ;
+  outHook = savedOut ;
+  outUser = savedUser ;
+} /* runLanes */
+
+#undef LANE
+#undef EACHLANE
+#undef BLEND
+#undef SETMASK
+#undef STOPLANE
+#undef GOTO
+#undef ALONE
+#undef VECOP
+#undef NEXTLANES
+
+#else
+
+void runLanes ( int n, char * text[], size_t len[], TMOUTHOOK out,
+                void * user[], STEPRESULT result[], long count[], long budget )
+{ TMOUTHOOK savedHook = outHook ;
+  void * savedUser = outUser ;
+  int l ;
+  for (l = 0 ; l < n ; l++)
+  { clearMachine () ;
+    inputEnded = FALSE ;
+    openText(text[l], len[l]) ;
+    outHook = out ;
+    outUser = user[l] ;
+    result[l] = runFor (&count[l], budget) ;
+  }
+  outHook = savedHook ;
+  outUser = savedUser ;
+} /* runLanes */
+
+#endif
+
+/********************************************/
+/* Snapshots: the registers, the dMem pages */
+/* in use and the instruction count of the  */
+/* bound machine, with a hash of its        */
+/* program, in a compact binary file: a     */
+/* header and then, for each page of dMem   */
+/* with a nonzero word or float, its number */
+/* and contents                             */
+/********************************************/
+#define   SNAPPAGE  1024   /* words of dMem in a page */
+
+typedef struct {
+   char magic [8] ;              /* "TMSNAP2" */
+   unsigned long long program ;  /* programHash () */
+   int iaddrSize, daddrSize ;
+   long long count ;
+   WORD reg [NO_REGS] ;
+   unsigned regFloat ;
+   int pages ;
+   } SNAPHEADER;
+
+#if defined(__unix__)
+pid_t snapChild = 0 ;          /* writing a snapshot */
+#endif
+
+/********************************************/
+unsigned long long programHash (void)
+{ unsigned long long h = 14695981039346656037ULL ;   /* FNV-1a */
+  int i, k, w [5] ;
+  for (i = 0 ; i < iaddrSize ; i++)
+  { w[0] = iMem[i].iop ;
+    w[1] = iMem[i].iarg1 ;
+    w[2] = iMem[i].iarg2.attr.valint ;
+    w[3] = iMem[i].iarg2.type ;
+    w[4] = iMem[i].iarg3 ;
+    for (k = 0 ; k < 5 * (int) sizeof(int) ; k++)
+    { h ^= ((unsigned char *) w)[k] ;
+      h *= 1099511628211ULL ;
     }
-    printf( "%s\n",stepResultTab[stepResult] );
   }
-  return TRUE;
-} /* doCommand */
+  return h ;
+} /* programHash */
 
+/* Function pageUsed tells whether page p of dMem,
+ * of n words, has a nonzero word or float
+ */
+int pageUsed ( int p, int n )
+{ int a ;
+  for (a = 0 ; a < (n + 31) / 32 ; a++)
+    if ( dFloat[p * (SNAPPAGE / 32) + a] != 0 ) return TRUE ;
+  for (a = 0 ; a < n ; a++)
+    if ( dVal[p * SNAPPAGE + a].valint != 0 ) return TRUE ;
+  return FALSE ;
+} /* pageUsed */
 
 /********************************************/
-/* E X E C U T I O N   B E G I N S   H E R E */
+void waitSnapshot (void)
+{
+#if defined(__unix__)
+  if ( snapChild > 0 ) waitpid(snapChild, NULL, 0) ;
+  snapChild = 0 ;
+#endif
+} /* waitSnapshot */
+
 /********************************************/
+int saveSnapshot ( const char * name, long count, int forked )
+{ SNAPHEADER h ;
+  FILE * f ;
+  char tmp [FILENAME_MAX] ;
+  int p, n, ok ;
+#if defined(__unix__)
+  pid_t pid = -1 ;
+  waitSnapshot () ;
+  fflush(stdout) ;
+  if ( forked )
+  { pid = fork () ;
+    if ( pid > 0 )   /* the child writes from its copy of the pages */
+    { snapChild = pid ;
+      return TRUE ;
+    }
+  }
+#endif
+  memset(&h, 0, sizeof(h)) ;
+  strcpy(h.magic, "TMSNAP2") ;
+  h.program = programHash () ;
+  h.iaddrSize = iaddrSize ;
+  h.daddrSize = daddrSize ;
+  h.count = count ;
+  memcpy(h.reg, regVal, sizeof(h.reg)) ;
+  h.regFloat = regFloat ;
+  for (p = 0 ; p * SNAPPAGE < daddrSize ; p++)
+  { n = (daddrSize - p * SNAPPAGE < SNAPPAGE) ? daddrSize - p * SNAPPAGE : SNAPPAGE ;
+    if ( pageUsed(p, n) ) h.pages++ ;
+  }
+  /* written aside and renamed, so a crash leaves the last one whole */
+  snprintf(tmp, sizeof(tmp), "%s.tmp", name) ;
+  f = fopen(tmp, "wb") ;
+  ok = (f != NULL) && (fwrite(&h, sizeof(h), 1, f) == 1) ;
+  for (p = 0 ; ok && (p * SNAPPAGE < daddrSize) ; p++)
+  { n = (daddrSize - p * SNAPPAGE < SNAPPAGE) ? daddrSize - p * SNAPPAGE : SNAPPAGE ;
+    if ( pageUsed(p, n) )
+      ok = (fwrite(&p, sizeof(p), 1, f) == 1)
+           && (fwrite(dVal + p * SNAPPAGE, sizeof(WORD), n, f) == (size_t) n)
+           && (fwrite(dFloat + p * (SNAPPAGE / 32), sizeof(unsigned), (n + 31) / 32, f)
+               == (size_t) (n + 31) / 32) ;
+  }
+  if ( f != NULL ) ok = (fclose(f) == 0) && ok ;
+  ok = ok && (rename(tmp, name) == 0) ;
+  if ( ! ok )
+  { fprintf(stderr, "cannot write snapshot %s\n", name) ;
+    remove(tmp) ;
+  }
+#if defined(__unix__)
+  if ( pid == 0 ) _exit(ok ? 0 : 1) ;
+#endif
+  return ok ;
+} /* saveSnapshot */
 
-int main( int argc, char * argv[] )
-{ if (argc != 2)
-  { printf("usage: %s <filename>\n",argv[0]);
-    exit(1);
+/********************************************/
+int loadSnapshot ( const char * name, long * count )
+{ SNAPHEADER h ;
+  FILE * f = fopen(name, "rb") ;
+  int i, p, n, ok ;
+  if ( f == NULL )
+  { printf("snapshot '%s' not found\n", name) ;
+    return FALSE ;
+  }
+  ok = (fread(&h, sizeof(h), 1, f) == 1) && (memcmp(h.magic, "TMSNAP2", 8) == 0) ;
+  if ( ! ok ) printf("%s is not a TM snapshot\n", name) ;
+  else if ( (h.iaddrSize != iaddrSize) || (h.daddrSize != daddrSize)
+            || (h.program != programHash ()) )
+  { printf("%s is a snapshot of another program, or of -i %d -d %d\n",
+           name, h.iaddrSize, h.daddrSize) ;
+    ok = FALSE ;
   }
-  strcpy(pgmName,argv[1]) ;
-  if (strchr (pgmName, '.') == NULL)
-     strcat(pgmName,".tm");
-  pgm = fopen(pgmName,"r");
-  if (pgm == NULL)
-  { printf("file '%s' not found\n",pgmName);
-    exit(1);
+  if ( ok )
+  { clearMachine () ;
+    memcpy(regVal, h.reg, sizeof(h.reg)) ;
+    regFloat = h.regFloat ;
+    *count = (long) h.count ;
+    for (i = 0 ; ok && (i < h.pages) ; i++)
+    { ok = (fread(&p, sizeof(p), 1, f) == 1) && (p >= 0) && (p * SNAPPAGE < daddrSize) ;
+      if ( ! ok ) break ;
+      n = (daddrSize - p * SNAPPAGE < SNAPPAGE) ? daddrSize - p * SNAPPAGE : SNAPPAGE ;
+      ok = (fread(dVal + p * SNAPPAGE, sizeof(WORD), n, f) == (size_t) n)
+           && (fread(dFloat + p * (SNAPPAGE / 32), sizeof(unsigned), (n + 31) / 32, f)
+               == (size_t) (n + 31) / 32) ;
+    }
+    if ( ! ok )
+    { printf("snapshot %s is cut short\n", name) ;
+      clearMachine () ;
+    }
   }
+  fclose(f) ;
+  return ok ;
+} /* loadSnapshot */
 
-  /* read the program */
-  if ( ! readInstructions ())
-         exit(1) ;
-  /* switch input file to terminal */
-  /* reset( input ); */
-  /* read-eval-print */
-  printf("TM  simulation (enter h for help)...\n");
-  do
-     done = ! doCommand ();
-  while (! done );
-  printf("Simulation done.\n");
-  return 0;
-}
+/********************************************/
+/* Machine contexts: everything that        */
+/* belongs to one loaded program and its    */
+/* machine. The globals above always hold   */
+/* the bound context; every other context   */
+/* keeps its own in a tmcontext, and        */
+/* bindContext trades them, so machines     */
+/* are independent and one can run inside   */
+/* the hook of another                      */
+/********************************************/
+struct tmcontext {
+      int iaddrSize, daddrSize, iMemSize ;
+      INSTRUCTION * iMem ;
+      WORD regVal [NO_REGS] ;
+      unsigned regFloat ;
+      WORD * dVal ;
+      char * dGuardEnd ;
+      unsigned * dFloat ;
+      RANGE regRange [NO_REGS] ;
+      char * addrProven ;
+      DINSTRUCTION * dCode ;
+      int dCodeThreaded ;
+      int programShared ;
+      int decodeShared ;
+      int decodeLent ;
+      DECODING * retired ;
+      BLOCK * blocks ;
+      int nBlocks ;
+      int * blockOf ;
+      char * leader ;
+      int inputEnded ;
+      TMINHOOK inHook ;
+      void * inUser ;
+      TMOUTHOOK outHook ;
+      void * outUser ;
+      FILE * msgOut ;
+#if defined(__x86_64__) && defined(__linux__)
+      unsigned char * jitCode ;
+      int jitLen ;
+      void ** jitEntry ;
+      int * jitLabel ;
+      int * jitSlowStub ;
+      JITFIXUP * jitFix ;
+      int nJitFix ;
+      int jitEntryAt ;
+      int jitCompiled ;
+#endif
+   } ;
+
+/* the context of the globals as the thread starts, and
+ * the bound one, NULL while that is firstContext
+ */
+TMLOCAL TMCONTEXT firstContext ;
+TMLOCAL TMCONTEXT * boundContext = NULL ;
+
+/* swap a global with the field of a context */
+template <class T> void exchange ( T & a, T & b )
+{ T t = a ; a = b ; b = t ;
+} /* exchange */
+
+template <class T, int N> void exchange ( T (& a) [N], T (& b) [N] )
+{ int i ;
+  for (i = 0 ; i < N ; i++) exchange(a[i], b[i]) ;
+} /* exchange */
+
+/********************************************/
+/* Procedure exchangeContext swaps the      */
+/* globals with c; done for the bound       */
+/* context and then for another, it makes   */
+/* that one bound                           */
+/********************************************/
+void exchangeContext ( TMCONTEXT * c )
+{ exchange(iaddrSize, c->iaddrSize) ;
+  exchange(daddrSize, c->daddrSize) ;
+  exchange(iMemSize, c->iMemSize) ;
+  exchange(iMem, c->iMem) ;
+  exchange(regVal, c->regVal) ;
+  exchange(regFloat, c->regFloat) ;
+  exchange(dVal, c->dVal) ;
+  exchange(dGuardEnd, c->dGuardEnd) ;
+  exchange(dFloat, c->dFloat) ;
+  exchange(regRange, c->regRange) ;
+  exchange(addrProven, c->addrProven) ;
+  exchange(dCode, c->dCode) ;
+  exchange(dCodeThreaded, c->dCodeThreaded) ;
+  exchange(programShared, c->programShared) ;
+  exchange(decodeShared, c->decodeShared) ;
+  exchange(decodeLent, c->decodeLent) ;
+  exchange(retired, c->retired) ;
+  exchange(blocks, c->blocks) ;
+  exchange(nBlocks, c->nBlocks) ;
+  exchange(blockOf, c->blockOf) ;
+  exchange(leader, c->leader) ;
+  exchange(inputEnded, c->inputEnded) ;
+  exchange(inHook, c->inHook) ;
+  exchange(inUser, c->inUser) ;
+  exchange(outHook, c->outHook) ;
+  exchange(outUser, c->outUser) ;
+  exchange(msgOut, c->msgOut) ;
+#if defined(__x86_64__) && defined(__linux__)
+  exchange(jitCode, c->jitCode) ;
+  exchange(jitLen, c->jitLen) ;
+  exchange(jitEntry, c->jitEntry) ;
+  exchange(jitLabel, c->jitLabel) ;
+  exchange(jitSlowStub, c->jitSlowStub) ;
+  exchange(jitFix, c->jitFix) ;
+  exchange(nJitFix, c->nJitFix) ;
+  exchange(jitEntryAt, c->jitEntryAt) ;
+  exchange(jitCompiled, c->jitCompiled) ;
+#endif
+} /* exchangeContext */
+
+/********************************************/
+/* Function newContext returns an unbound   */
+/* context with no program, isize words of  */
+/* iMem (0: sized from the program) and     */
+/* dsize words of dMem                      */
+/********************************************/
+TMCONTEXT * newContext ( int isize, int dsize )
+{ TMCONTEXT * c = (TMCONTEXT *) calloc(1, sizeof(TMCONTEXT)) ;
+  if ( c == NULL )
+  { printf("out of memory\n") ;
+    exit(1) ;
+  }
+  c->iaddrSize = isize ;
+  c->daddrSize = dsize ;
+  return c ;
+} /* newContext */
+
+/********************************************/
+/* Function shareContext returns an unbound */
+/* context with a machine of its own that   */
+/* runs the program of image, read-only, so */
+/* any number of threads can run it at      */
+/* once; image must not be reloaded or      */
+/* freed while the context is used         */
+/********************************************/
+TMCONTEXT * shareContext ( TMCONTEXT * image )
+{ TMCONTEXT * c ;
+  int bound = (image == boundContext) ;
+  if ( bound ) exchangeContext(image) ;   /* its program is in image meanwhile */
+  c = newContext(image->iaddrSize, image->daddrSize) ;
+  c->iMemSize = image->iMemSize ;
+  c->iMem = image->iMem ;
+  memcpy(c->regRange, image->regRange, sizeof(c->regRange)) ;
+  c->addrProven = image->addrProven ;
+  c->dCode = image->dCode ;
+  c->dCodeThreaded = image->dCodeThreaded ;
+  c->programShared = TRUE ;
+  c->decodeShared = TRUE ;
+  image->decodeLent = TRUE ;
+  c->blocks = image->blocks ;
+  c->nBlocks = image->nBlocks ;
+  c->blockOf = image->blockOf ;
+  c->leader = image->leader ;
+  if ( bound ) exchangeContext(image) ;
+  return c ;
+} /* shareContext */
+
+/********************************************/
+/* Function bindContext makes c the context */
+/* of the globals and returns the one bound */
+/* before, for binding back                 */
+/********************************************/
+TMCONTEXT * bindContext ( TMCONTEXT * c )
+{ TMCONTEXT * before = (boundContext != NULL) ? boundContext : &firstContext ;
+  if ( c != before )
+  { exchangeContext(before) ;
+    exchangeContext(c) ;
+    boundContext = c ;
+  }
+  return before ;
+} /* bindContext */
+
+/********************************************/
+/* Procedure freeMachine returns the memory */
+/* of the program, unless shared, and the   */
+/* machine of the bound context, leaving it */
+/* with none                                */
+/********************************************/
+void freeMachine (void)
+{ if ( ! programShared )
+    unmapZero(iMem, (size_t) iMemSize * sizeof(INSTRUCTION)) ;
+  if ( retired != NULL )
+  { unmapZero(retired->addrProven, iaddrSize) ;
+    unmapZero(retired->dCode, (size_t) (iaddrSize + 1) * sizeof(DINSTRUCTION)) ;
+    unmapZero(retired->leader, iaddrSize + 1) ;
+    unmapZero(retired->blocks, (size_t) iaddrSize * sizeof(BLOCK)) ;
+    unmapZero(retired->blockOf, (size_t) iaddrSize * sizeof(int)) ;
+    free(retired) ;
+    retired = NULL ;
+  }
+  if ( ! decodeShared )
+  { unmapZero(addrProven, iaddrSize) ;
+    unmapZero(dCode, (size_t) (iaddrSize + 1) * sizeof(DINSTRUCTION)) ;
+    unmapZero(leader, iaddrSize + 1) ;
+    unmapZero(blocks, (size_t) iaddrSize * sizeof(BLOCK)) ;
+    unmapZero(blockOf, (size_t) iaddrSize * sizeof(int)) ;
+  }
+  programShared = decodeShared = decodeLent = FALSE ;
+  iMem = NULL ;
+  iMemSize = 0 ;
+  addrProven = NULL ;
+  dCode = NULL ;
+  dCodeThreaded = FALSE ;
+  leader = NULL ;
+  blocks = NULL ;
+  blockOf = NULL ;
+  nBlocks = 0 ;
+  freeMemory () ;
+#if defined(__x86_64__) && defined(__linux__)
+  if ( jitCode != NULL )
+  { munmap(jitCode, JIT_CODE_SIZE) ;
+    unmapZero(jitEntry, (size_t) iaddrSize * sizeof(void *)) ;
+    unmapZero(jitLabel, (size_t) iaddrSize * sizeof(int)) ;
+    unmapZero(jitSlowStub, (size_t) iaddrSize * sizeof(int)) ;
+    unmapZero(jitFix, (size_t) iaddrSize * 4 * sizeof(JITFIXUP)) ;
+    jitCode = NULL ;
+  }
+  jitCompiled = FALSE ;
+#endif
+} /* freeMachine */
+
+/********************************************/
+/* Procedure unproveReg drops what the      */
+/* decoded program assumes of the registers */
+/* once reg(r) was set from outside the     */
+/* program to a value the verifier did not  */
+/* bound: every register is then unknown,   */
+/* and the program is decoded again, into   */
+/* arrays of its own if it was shared with  */
+/* other contexts                           */
+/********************************************/
+void unproveReg ( int r )
+{ int i ;
+  if ( (iMem == NULL) || (r < 0) || (r >= NO_REGS) || ! regRange[r].known ) return ;
+  if ( ! ((regFloat >> r) & 1u) && (regVal[r].valint >= regRange[r].lo)
+       && (regVal[r].valint <= regRange[r].hi) ) return ;
+  if ( decodeLent )
+  { /* the sharers keep running it: freed with the program */
+    retired = (DECODING *) calloc(1, sizeof(DECODING)) ;
+    if ( retired == NULL )
+    { printf("out of memory\n") ;
+      exit(1) ;
+    }
+    retired->dCode = dCode ;
+    retired->addrProven = addrProven ;
+    retired->leader = leader ;
+    retired->blocks = blocks ;
+    retired->blockOf = blockOf ;
+  }
+  if ( decodeShared || decodeLent )
+  { addrProven = NULL ;
+    dCode = NULL ;
+    leader = NULL ;
+    blocks = NULL ;
+    blockOf = NULL ;
+    decodeShared = decodeLent = FALSE ;
+  }
+  for (i = 0 ; i < NO_REGS ; i++) regRange[i].known = FALSE ;
+  if ( addrProven == NULL ) addrProven = (char *) mapZero(iaddrSize) ;
+  else clearZero(addrProven, iaddrSize) ;
+  decodeInstructions () ;
+  fuseInstructions () ;
+  threadInstructions () ;
+#if defined(__x86_64__) && defined(__linux__)
+  jitCompiled = FALSE ;
+#endif
+} /* unproveReg */
+
+/********************************************/
+/* Procedure freeContext returns the memory */
+/* of c and c itself; if c is bound, the    */
+/* first context is bound instead           */
+/********************************************/
+void freeContext ( TMCONTEXT * c )
+{ TMCONTEXT * before = bindContext(c) ;
+  freeMachine () ;
+  bindContext( (before == c) ? &firstContext : before ) ;
+  free(c) ;
+} /* freeContext */
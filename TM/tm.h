@@ -0,0 +1,415 @@
+/****************************************************/
+/* File: tm.h                                       */
+/* Types and loader interface of the TM             */
+/* ("Tiny Machine") computer                        */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#ifndef _TM_H_
+#define _TM_H_
+
+#include <stdio.h>
+
+#ifndef TRUE
+#define TRUE 1
+#endif
+#ifndef FALSE
+#define FALSE 0
+#endif
+
+/* the machine state below is kept per thread: each
+ * thread binds its own context, so that threads can
+ * run machines at once
+ */
+#if defined(__GNUC__)
+#define TMLOCAL __thread
+#else
+#define TMLOCAL thread_local
+#endif
+
+/******* const *******/
+#define   IADDR_SIZE  1024 /* smallest iMem sized from the program */
+#define   DADDR_SIZE  1024 /* default dMem */
+#define   IADDR_MAX   (1 << 24) /* largest iMem */
+#define   DADDR_MAX   (1 << 28) /* largest dMem */
+#define   NO_REGS 32 /* 0..7 as ever, 8..31 of the extended ISA */
+#define   PC_REG  7
+
+#define   LINESIZE  121
+#define   WORDSIZE  20
+
+/******* type  *******/
+
+typedef enum {
+   opclRR,     /* reg operands r,s,t */
+   opclRM,     /* reg r, mem d+s */
+   opclRA      /* reg r, int d+s */
+   } OPCLASS;
+
+typedef enum {
+   /* RR instructions */
+   opHALT,    /* RR     halt, operands are ignored */
+   opIN,      /* RR     read into reg(r); s and t are ignored */
+   opOUT,     /* RR     write from reg(r), s and t are ignored */
+   opADD,    /* RR     reg(r) = reg(s)+reg(t) */
+   opSUB,    /* RR     reg(r) = reg(s)-reg(t) */
+   opXOR,    /* RR     reg(r) = reg(s)^reg(t)*/
+   opMUL,    /* RR     reg(r) = reg(s)*reg(t) */
+   opDIV,    /* RR     reg(r) = reg(s)/reg(t) */
+   opRRLim,   /* limit of RR opcodes */
+
+   /* RM instructions */
+   opLD,      /* RM     reg(r) = mem(d+reg(s)) */
+   opST,      /* RM     mem(d+reg(s)) = reg(r) */
+   opRMLim,   /* Limit of RM opcodes */
+
+   /* RA instructions */
+   opLDA,     /* RA     reg(r) = d+reg(s) */
+   opLDC,     /* RA     reg(r) = d ; reg(s) is ignored */
+   opADDI,    /* RA     reg(r) = reg(s)+d, as LDA */
+   opMULI,    /* RA     reg(r) = reg(s)*d */
+   opJLT,     /* RA     if reg(r)<0 then reg(7) = d+reg(s) */
+   opJLE,     /* RA     if reg(r)<=0 then reg(7) = d+reg(s) */
+   opJGT,     /* RA     if reg(r)>0 then reg(7) = d+reg(s) */
+   opJGE,     /* RA     if reg(r)>=0 then reg(7) = d+reg(s) */
+   opJEQ,     /* RA     if reg(r)==0 then reg(7) = d+reg(s) */
+   opJNE,     /* RA     if reg(r)!=0 then reg(7) = d+reg(s) */
+   opRALim    /* Limit of RA opcodes */
+   } OPCODE;
+
+typedef enum {
+   srOKAY,
+   srHALT,
+   srIMEM_ERR,
+   srDMEM_ERR,
+   srZERODIVIDE,
+   srTYPE_ERR,
+   srMEM_FLOAT,
+   srBREAK,      /* stopped before a breakpoint */
+   srWATCH,      /* stopped after a store to a watched location */
+   srNO_INPUT    /* IN at the end of the input; pc stays at the IN */
+   } STEPRESULT;
+
+typedef enum{INT,FLOAT} NumType;
+typedef struct {union {int valint; float valfloat;} attr; NumType type;} NUM;
+
+/* a raw register or memory cell; whether it holds
+ * an int or a float is kept apart in a type bitmap
+ */
+typedef union {int valint; float valfloat;} WORD;
+
+typedef struct {
+      int iop  ;
+      int iarg1  ;
+      NUM iarg2  ;
+      int iarg3  ;
+   } INSTRUCTION;
+
+/******** memory sizes ********/
+extern TMLOCAL int iaddrSize;   /* words of iMem: 0 until set with -i or
+                                 * by readInstructions from the program */
+extern TMLOCAL int daddrSize;   /* words of dMem, DADDR_SIZE unless set with -d */
+extern int hugePages;           /* TRUE: ask for huge pages on large memories */
+extern int guardMemory;         /* TRUE: guard dVal, for the JIT */
+
+/* Function sizeOption handles the -i n and -d n
+ * options, returning FALSE for any other option
+ */
+int sizeOption ( char * opt, char * arg ) ;
+
+/* Function mapZero returns size bytes of zeroed
+ * memory; with mmap, pages cost nothing until touched
+ */
+void * mapZero ( size_t size ) ;
+void unmapZero ( void * p, size_t size ) ;
+
+/* Procedure clearZero zeroes size bytes at p,
+ * dropping whole pages back to the system
+ */
+void clearZero ( void * p, size_t size ) ;
+
+/******** loaded program and machine state ********/
+extern TMLOCAL INSTRUCTION * iMem;         /* iaddrSize instructions */
+extern TMLOCAL int iMemSize;               /* instructions it has room for */
+extern TMLOCAL WORD regVal [NO_REGS];
+extern TMLOCAL unsigned regFloat;          /* bit r set: reg(r) is FLOAT */
+extern TMLOCAL WORD * dVal;                /* daddrSize words */
+extern TMLOCAL unsigned * dFloat;          /* bit a set: mem(a) is FLOAT */
+
+/* tagged views of the register file and dMem,
+ * inline: stepTM goes through them every step
+ */
+inline NUM getReg ( int r )
+{ NUM v ;
+  v.attr.valint = regVal[r].valint ;
+  v.type = ((regFloat >> r) & 1) ? FLOAT : INT ;
+  return v ;
+} /* getReg */
+
+inline void setReg ( int r, NUM v )
+{ regVal[r].valint = v.attr.valint ;
+  if (v.type == FLOAT) regFloat |= 1u << r ;
+  else regFloat &= ~(1u << r) ;
+} /* setReg */
+
+inline NUM getMem ( int a )
+{ NUM v ;
+  v.attr.valint = dVal[a].valint ;
+  v.type = ((dFloat[a >> 5] >> (a & 31)) & 1) ? FLOAT : INT ;
+  return v ;
+} /* getMem */
+
+inline void setMem ( int a, NUM v )
+{ dVal[a].valint = v.attr.valint ;
+  if (v.type == FLOAT) dFloat[a >> 5] |= 1u << (a & 31) ;
+  else dFloat[a >> 5] &= ~(1u << (a & 31)) ;
+} /* setMem */
+
+/* bytes of PROT_NONE after dVal: dVal[i] faults for
+ * every unsigned 32-bit i >= daddrSize
+ */
+#define   DGUARD_SIZE  ((size_t) 4 << 32)
+
+/* end of the guard region after dVal, or NULL if
+ * dVal is not guarded and needs bounds checks
+ */
+extern TMLOCAL char * dGuardEnd;
+
+void allocMemory (void) ;
+void freeMemory (void) ;
+
+/* Procedure clearMachine zeroes the registers
+ * and dMem, except mem(0) = daddrSize-1,
+ * allocating dMem on first use
+ */
+void clearMachine (void) ;
+
+extern char * opCodeTab[];
+extern char * stepResultTab[];
+
+extern TMLOCAL FILE *pgm  ;
+
+/******** line scanner, shared with the command loop ********/
+extern TMLOCAL char in_Line[LINESIZE] ;
+extern TMLOCAL int lineLen ;
+extern TMLOCAL int inCol  ;
+extern TMLOCAL int num  ;
+extern TMLOCAL NUM _num  ;
+extern TMLOCAL char word[WORDSIZE] ;
+extern TMLOCAL char ch  ;
+
+int opClass( int c ) ;
+
+/* Function printInstruction prints the instruction
+ * at loc to f, with no newline, and returns the
+ * number of characters printed
+ */
+int printInstruction ( FILE * f, int loc ) ;
+void getCh (void) ;
+
+/* Function getLine reads a line of standard
+ * input into in_Line; FALSE at end of input
+ */
+int getLine (void) ;
+int nonBlank (void) ;
+int getNum (void) ;
+int getWord (void) ;
+int skipCh ( char c ) ;
+int atEOL (void) ;
+int error( char * msg, int lineNo, int instNo) ;
+
+/* Function readInstructions clears the machine
+ * and loads the program in pgm into iMem, setting
+ * iaddrSize from it unless it is already set;
+ * FALSE (after a message) on a syntax error
+ */
+int readInstructions (void) ;
+
+/******** binary trace of tm --trace ********/
+
+#define   TRACE_MAGIC  "TMTRACE2"
+#define   TRACE_RING   (1 << 20) /* default records kept */
+
+/* one executed instruction */
+typedef struct {
+      int pc  ;
+      unsigned char op  ;       /* OPCODE */
+      unsigned char reg  ;      /* its first operand register */
+      unsigned char isFloat  ;  /* reg holds a float afterwards */
+      unsigned char pad  ;
+      WORD value  ;             /* reg after the instruction */
+      int addr  ;               /* dMem address of an LD or ST, else -1 */
+   } TRACERECORD;
+
+/* the file is this header followed by a ring of records:
+ * instruction i of the run is record i % records, and
+ * the last min(count, records) of them are kept
+ */
+typedef struct {
+      char magic[8]  ;
+      int records  ;            /* a power of 2 */
+      int result  ;             /* STEPRESULT of the run */
+      long count  ;
+   } TRACEHEADER;
+
+/******** static verifier ********/
+
+/* the int values a register can hold at any point
+ * of any run; known is FALSE when nothing is proven
+ */
+typedef struct { int known ; int lo, hi ; } RANGE ;
+
+extern TMLOCAL RANGE regRange [NO_REGS] ;
+
+/* TRUE if the LD or ST at loc always addresses dMem
+ * with an int base, so it needs no run-time check
+ */
+extern TMLOCAL char * addrProven ;
+
+/* Function constReg returns TRUE if reg(r) always
+ * holds the int *c
+ */
+int constReg ( int r, int * c ) ;
+
+/* Procedure verifyInstructions computes regRange
+ * and addrProven for the program in iMem
+ */
+void verifyInstructions (void) ;
+
+/******** execution (tm.cpp) ********/
+
+extern char pgmName[120];
+extern int traceflag;                      /* print each instruction */
+
+/* breakpoints and watchpoints of the command loop */
+extern char * breakAt;                     /* iaddrSize+1 flags */
+extern int nBreaks;
+extern char * watchAt;                     /* daddrSize flags */
+extern int nWatches;
+extern int watchHit;                       /* location that stopped a run */
+
+typedef enum {
+   outTEXT,     /* "OUT instruction prints: " and the value, as printf */
+   outPLAIN,    /* the value, floats shortest round-trip */
+   outBINARY    /* the raw 4-byte word */
+   } OUTFORMAT;
+
+#define   OUTVALUE  128  /* longest value as formatted */
+
+extern int batchOutput;                    /* OUT buffered, in outFormat */
+extern OUTFORMAT outFormat;
+extern TMLOCAL FILE * msgOut;
+
+/* Procedure openInput makes IN read standard
+ * input with no prompts, for a batch run;
+ * openText makes IN of this thread read the len
+ * bytes at text instead
+ */
+void openInput (void) ;
+void openText ( char * text, size_t len ) ;
+void flushOut (void) ;
+
+/* Function formatOut writes v at p as OUT
+ * does in outFormat, returning its end
+ */
+char * formatOut ( char * p, NUM v ) ;
+
+/* IN and OUT hooks of a machine: an input hook
+ * stores the next value in *v, returning FALSE at
+ * the end of its input; each gets its user pointer.
+ * With no hooks, IN and OUT use standard input and
+ * output
+ */
+typedef int (* TMINHOOK) ( void * user, NUM * v ) ;
+typedef void (* TMOUTHOOK) ( void * user, NUM v ) ;
+
+extern TMLOCAL int inputEnded;             /* an IN found no more input */
+extern TMLOCAL TMINHOOK inHook;
+extern TMLOCAL void * inUser;
+extern TMLOCAL TMOUTHOOK outHook;
+extern TMLOCAL void * outUser;
+
+void writeInstruction ( int loc ) ;
+
+/* Procedures decodeInstructions and fuseInstructions
+ * prepare the program in iMem for the run loops,
+ * after verifyInstructions
+ */
+void decodeInstructions (void) ;
+void fuseInstructions (void) ;
+
+/* Procedure threadInstructions sets the dispatch
+ * of the decoded program, after which nothing
+ * writes to it while it runs
+ */
+void threadInstructions (void) ;
+
+/* Procedure unproveReg decodes the program again
+ * with no register assumed known, unless reg(r),
+ * just set from outside the program, stays in the
+ * range the verifier proved for it
+ */
+void unproveReg ( int r ) ;
+
+/* Functions stepTM ... runJIT execute from
+ * reg(PC_REG), one instruction or until a result
+ * other than srOKAY, storing the number of
+ * instructions executed in *icount
+ */
+STEPRESULT stepTM (void) ;
+STEPRESULT runTM ( long * icount ) ;
+STEPRESULT runFor ( long * icount, long limit ) ;
+STEPRESULT runDebug ( long * icount, long limit ) ;
+STEPRESULT runProfile ( long * icount ) ;
+STEPRESULT runTrace ( long * icount, char * name, long records ) ;
+STEPRESULT runJIT ( long * icount ) ;
+
+#define   MAXLANES  16
+
+/* Procedure runLanes runs the program from pc 0 on
+ * n (up to MAXLANES) fresh machines at once, lane l
+ * reading IN from the len[l] bytes at text[l] and
+ * passing OUT to out with user[l], or to writeOut if
+ * out is NULL; it stores the result and instruction
+ * count of each. With budget > 0 each lane stops as
+ * runFor does. The bound machine is to be cleared
+ * after
+ */
+void runLanes ( int n, char * text[], size_t len[], TMOUTHOOK out,
+                void * user[], STEPRESULT result[], long count[],
+                long budget ) ;
+
+/* Function wallClock returns seconds from an
+ * arbitrary origin; jsonString writes s to f as a
+ * JSON string
+ */
+double wallClock (void) ;
+void jsonString ( FILE * f, char * s ) ;
+
+/* Function saveSnapshot writes the registers, the
+ * dMem pages in use and count to file name, with a
+ * hash of the program; if forked, a child process
+ * writes them, and the run goes on at once.
+ * waitSnapshot waits for that child. loadSnapshot
+ * reads one back into the machine, which must have
+ * the same program and sizes, storing its count.
+ * Each is FALSE after a message if it cannot
+ */
+int saveSnapshot ( const char * name, long count, int forked ) ;
+void waitSnapshot (void) ;
+int loadSnapshot ( const char * name, long * count ) ;
+
+/* the program, machine state and hooks of one
+ * machine; the globals above belong to the one
+ * bound in this thread
+ */
+typedef struct tmcontext TMCONTEXT;
+
+TMCONTEXT * newContext ( int isize, int dsize ) ;
+TMCONTEXT * shareContext ( TMCONTEXT * image ) ;
+TMCONTEXT * bindContext ( TMCONTEXT * c ) ;
+void freeMachine (void) ;
+void freeContext ( TMCONTEXT * c ) ;
+
+#endif
@@ -0,0 +1,374 @@
+/****************************************************/
+/* File: tm2c.c                                     */
+/* Ahead-of-time translator from TM code to C       */
+/* The generated program runs like 'tm --run'       */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tm.h"
+
+char pgmName[120];
+char outName[124];
+FILE * out ;
+
+int last ;   /* highest location that is not HALT 0,0,0 */
+
+/* runtime emitted in front of the translated program;
+ * it repeats the NUM semantics of stepTM
+ */
+static const char * prelude =
+"#include <stdio.h>\n"
+"#include <stdlib.h>\n"
+"#include <string.h>\n"
+"#include <ctype.h>\n"
+"\n"
+"#define IADDR_SIZE %d\n"
+"#define DADDR_SIZE %d\n"
+"#define NO_REGS %d\n"
+"\n"
+"enum { INT, FLOAT } ;\n"
+"enum { srOKAY, srHALT, srIMEM_ERR, srDMEM_ERR, srZERODIVIDE,\n"
+"       srTYPE_ERR, srMEM_FLOAT, srNO_INPUT } ;\n"
+"typedef struct { union { int i ; float f ; } v ; int t ; } NUM ;\n"
+"\n"
+"static const char * stepResultTab[] =\n"
+"  { \"OK\", \"Halted\", \"Instruction Memory Fault\", \"Data Memory Fault\",\n"
+"    \"Division by 0\", \"Type Error\", \"Memory FLoat\", \"End of Input\" } ;\n"
+"\n"
+"static NUM M [DADDR_SIZE] ;\n"
+"\n" ;
+
+/* the input routines, emitted only for a program
+ * with an IN so that the C compiles clean with -Wall
+ */
+static const char * inputPrelude =
+"/* input: values separated by white space, read in blocks with\n"
+"   no prompts; the parse is readBatch of tm --run */\n"
+"static char inBuf[65536] ;\n"
+"static int inPos, inLen ;\n"
+"\n"
+"static int inCh ( void )\n"
+"{ if (inPos == inLen)\n"
+"  { inLen = (int) fread(inBuf, 1, sizeof(inBuf), stdin) ;\n"
+"    inPos = 0 ;\n"
+"    if (inLen == 0) return EOF ;\n"
+"  }\n"
+"  return (unsigned char) inBuf[inPos++] ;\n"
+"}\n"
+"\n"
+"static int readIn ( NUM * v )\n"
+"{ char tok[64], * p, * end ; unsigned u ; int c, len, neg, d ;\n"
+"  for (;;)\n"
+"  { do c = inCh() ; while ((c != EOF) && isspace(c)) ;\n"
+"    if (c == EOF) return 0 ;\n"
+"    for (len = 0 ; (c != EOF) && ! isspace(c) ; c = inCh())\n"
+"      if (len < 63) tok[len++] = (char) c ;\n"
+"    tok[len] = '\\0' ;\n"
+"    for (p = tok, neg = 0 ; (*p == '+') || (*p == '-') ; p++)\n"
+"      if (*p == '-') neg = ! neg ;\n"
+"    for (u = 0, d = 0 ; isdigit((unsigned char)p[d]) ; d++)\n"
+"      u = u * 10 + (p[d] - '0') ;\n"
+"    if ((d > 0) && (p[d] == '\\0'))\n"
+"    { v->v.i = (int) (neg ? 0u - u : u) ; v->t = INT ; return 1 ; }\n"
+"    if ((*p != '\\0') && (strspn(p, \"0123456789.eE+-\") == strlen(p))\n"
+"        && (strpbrk(p, \"0123456789\") != NULL))\n"
+"    { v->v.f = strtof(p, &end) ;\n"
+"      if (*end == '\\0')\n"
+"      { if (neg) v->v.f = - v->v.f ;\n"
+"        v->t = FLOAT ;\n"
+"        if (v->v.f == (int)v->v.f) { v->v.i = (int)v->v.f ; v->t = INT ; }\n"
+"        return 1 ;\n"
+"      }\n"
+"    }\n"
+"    printf(\"Illegal value\\n\") ;\n"
+"  }\n"
+"}\n"
+"\n" ;
+
+static const char * machinePrelude =
+"static void writeOut ( NUM v )\n"
+"{ if (v.t == INT) printf(\"OUT instruction prints: %%d\\n\", v.v.i) ;\n"
+"  else printf(\"OUT instruction prints: %%f\\n\", v.v.f) ;\n"
+"}\n"
+"\n"
+"#define FAULT(res)  { result = (res) ; goto done ; }\n"
+"#define SETPC(x)    { R[7].v.i = (x) ; R[7].t = INT ; }\n"
+"#define GOTOPC()    { pc = R[7].v.i ; goto dispatch ; }\n"
+"\n"
+"/* reg(r) = reg(s) op reg(t): int-int, or float with int operands converted */\n"
+"#define ARITH(x,y,z,op)                                                   \\\n"
+"  { NUM _a = R[y], _b = R[z] ;                                            \\\n"
+"    if ((_a.t == INT) && (_b.t == INT))                                   \\\n"
+"    { R[x].v.i = _a.v.i op _b.v.i ; R[x].t = INT ; }                      \\\n"
+"    else                                                                  \\\n"
+"    { R[x].v.f = (_a.t == INT ? (float)_a.v.i : _a.v.f)                   \\\n"
+"                 op (_b.t == INT ? (float)_b.v.i : _b.v.f) ;              \\\n"
+"      R[x].t = FLOAT ; }                                                  \\\n"
+"  }\n"
+"\n"
+"/* m = d + reg(s), int if both are int */\n"
+"#define EFFADDR(d,dt,s)                                                   \\\n"
+"  { if ((dt == INT) && (R[s].t == INT))                                   \\\n"
+"    { m.v.i = (d).i + R[s].v.i ; m.t = INT ; }                            \\\n"
+"    else                                                                  \\\n"
+"    { m.v.f = (dt == INT ? (float)(d).i : (d).f)                          \\\n"
+"              + (R[s].t == INT ? (float)R[s].v.i : R[s].v.f) ;            \\\n"
+"      m.t = FLOAT ; }                                                     \\\n"
+"  }\n"
+"\n"
+"/* reg(r) = reg(s) * d, as ARITH */\n"
+"#define MULI(x,y,d,dt)                                                    \\\n"
+"  { NUM _a = R[y] ;                                                       \\\n"
+"    if ((dt == INT) && (_a.t == INT))                                     \\\n"
+"    { R[x].v.i = _a.v.i * (d).i ; R[x].t = INT ; }                        \\\n"
+"    else                                                                  \\\n"
+"    { R[x].v.f = (_a.t == INT ? (float)_a.v.i : _a.v.f)                   \\\n"
+"                 * (dt == INT ? (float)(d).i : (d).f) ;                   \\\n"
+"      R[x].t = FLOAT ; }                                                  \\\n"
+"  }\n"
+"\n"
+"/* a = d + reg(s) as a data address */\n"
+"#define ADDR(d,s)                                                         \\\n"
+"  { if (R[s].t != INT) FAULT(srMEM_FLOAT) ;                               \\\n"
+"    a = (d) + R[s].v.i ;                                                  \\\n"
+"    if ((a < 0) || (a >= DADDR_SIZE)) FAULT(srDMEM_ERR) ;                 \\\n"
+"  }\n"
+"\n"
+"int main ( int argc, char * argv[] )\n"
+"{ NUM R[NO_REGS], m ;\n"
+"  union { int i ; float f ; } d ;\n"
+"  long n = 0 ;\n"
+"  int pc, a, result ;\n"
+"  int pflag = (argc > 1) && (strcmp(argv[1], \"-p\") == 0) ;\n"
+"  memset(R, 0, sizeof(R)) ;\n"
+"  M[0].v.i = DADDR_SIZE - 1 ;\n"
+"  (void) d ; (void) m ; (void) a ;\n"
+"  pc = 0 ;\n"
+"  goto dispatch ;\n"
+"\n" ;
+
+static const char * postlude =
+"\n"
+"Lhalt : n++ ;\n"
+"  printf(\"HALT: 0,0,0\\n\") ;\n"
+"  FAULT(srHALT) ;\n"
+"imem : n++ ;\n"
+"  FAULT(srIMEM_ERR) ;\n"
+"done :\n"
+"  if ( pflag )\n"
+"    printf(\"Number of instructions executed = %%ld\\n\", n) ;\n"
+"  printf(\"%%s\\n\", stepResultTab[result]) ;\n"
+"  return (result == srHALT) ? 0 : 1 ;\n"
+"}\n" ;
+
+/********************************************/
+/* Function readsPC returns TRUE if the     */
+/* instruction at loc reads reg(7) other    */
+/* than as a foldable base register         */
+/********************************************/
+int readsPC ( INSTRUCTION * ip )
+{ switch ( ip->iop )
+  { case opHALT : case opIN : return FALSE ;
+    case opOUT : return ip->iarg1 == PC_REG ;
+    case opADD : case opSUB : case opXOR : case opMUL : case opDIV :
+      return (ip->iarg2.attr.valint == PC_REG) || (ip->iarg3 == PC_REG) ;
+    case opST : return ip->iarg1 == PC_REG ;
+    case opLD : case opLDC : return FALSE ;
+    default :
+      if ( (ip->iop >= opJLT) && (ip->iarg1 == PC_REG) ) return TRUE ;
+      return (ip->iarg3 == PC_REG) && (ip->iarg2.type != INT) ;
+  }
+} /* readsPC */
+
+/********************************************/
+/* Procedure emitGoto emits a transfer of   */
+/* control to the location in reg(7), or to */
+/* target when it is a known int            */
+/********************************************/
+void emitGoto ( int known, int target )
+{ if ( ! known ) fprintf(out, " GOTOPC() ;") ;
+  else if ( (target >= 0) && (target <= last) ) fprintf(out, " goto L%d ;", target) ;
+  else fprintf(out, " { pc = %d ; goto dispatch ; }", target) ;
+} /* emitGoto */
+
+/********************************************/
+/* Procedure emitEffAddr emits m = d+reg(s) */
+/* and returns TRUE with the value in *c    */
+/* when it is a known int: s is the pc or   */
+/* a register the verifier proved constant  */
+/********************************************/
+int emitEffAddr ( INSTRUCTION * ip, int loc, int * c )
+{ int base = loc + 1 ;
+  if ( (ip->iarg2.type == INT)
+       && ((ip->iarg3 == PC_REG) || constReg(ip->iarg3, &base)) )
+  { *c = base + ip->iarg2.attr.valint ;
+    fprintf(out, " m.v.i = %d ; m.t = INT ;", *c) ;
+    return TRUE ;
+  }
+  fprintf(out, " d.i = %d ; EFFADDR(d,%s,%d) ;", ip->iarg2.attr.valint,
+          (ip->iarg2.type == INT) ? "INT" : "FLOAT", ip->iarg3) ;
+  return FALSE ;
+} /* emitEffAddr */
+
+/********************************************/
+/* Procedure emitInstruction translates the */
+/* instruction at loc                       */
+/********************************************/
+void emitInstruction ( int loc )
+{ INSTRUCTION * ip = &iMem[loc] ;
+  int r = ip->iarg1, s = ip->iarg2.attr.valint, t = ip->iarg3 ;
+  int known = FALSE, c = 0, a, base = loc + 1 ;
+  static const char * cond[] = { "<", "<=", ">", ">=", "==", "!=" } ;
+  static const char * arith[] = { "+", "-", "^", "*", "/" } ;
+
+  fprintf(out, "L%d : n++ ;", loc) ;
+  if ( readsPC(ip) ) fprintf(out, " SETPC(%d) ;", loc + 1) ;
+  switch ( ip->iop )
+  { case opHALT :
+      fprintf(out, " printf(\"HALT: %1d,%1d,%1d\\n\") ; FAULT(srHALT) ;",
+              r, s, t) ;
+      break;
+    case opIN :  fprintf(out, " if (! readIn(&R[%d])) { n-- ; FAULT(srNO_INPUT) ; }", r) ; break;
+    case opOUT : fprintf(out, " writeOut(R[%d]) ;", r) ; break;
+    case opXOR :
+      fprintf(out, " if ((R[%d].t != INT) || (R[%d].t != INT)) FAULT(srTYPE_ERR) ;"
+                   " R[%d].v.i = R[%d].v.i ^ R[%d].v.i ; R[%d].t = INT ;",
+              s, t, r, s, t, r) ;
+      break;
+    case opDIV :
+      fprintf(out, " if (R[%d].v.f == 0) FAULT(srZERODIVIDE) ;", t) ;
+      /* fall through */
+    case opADD : case opSUB : case opMUL :
+      fprintf(out, " ARITH(%d,%d,%d,%s) ;", r, s, t, arith[ip->iop - opADD]) ;
+      break;
+    case opLD :
+    case opST :
+      if ( ip->iarg2.type != INT )
+      { fprintf(out, " FAULT(srMEM_FLOAT) ;") ;
+        break;
+      }
+      if ( (t == PC_REG) || constReg(t, &base) )
+      { a = base + s ;
+        if ( (a < 0) || (a >= daddrSize) )
+        { fprintf(out, " FAULT(srDMEM_ERR) ;") ;
+          break;
+        }
+        fprintf(out, " a = %d ;", a) ;
+      }
+      else if ( addrProven[loc] ) fprintf(out, " a = %d + R[%d].v.i ;", s, t) ;
+      else fprintf(out, " ADDR(%d,%d) ;", s, t) ;
+      if ( ip->iop == opST ) fprintf(out, " M[a] = R[%d] ;", r) ;
+      else fprintf(out, " R[%d] = M[a] ;", r) ;
+      break;
+    case opLDA :
+    case opADDI :
+      known = emitEffAddr(ip, loc, &c) ;
+      fprintf(out, " R[%d] = m ;", r) ;
+      break;
+    case opLDC :
+      known = (ip->iarg2.type == INT) ;
+      c = s ;
+      fprintf(out, " R[%d].v.i = %d ; R[%d].t = %s ;", r, s, r,
+              known ? "INT" : "FLOAT") ;
+      break;
+    case opMULI :
+      if ( (ip->iarg2.type == INT) && ((t == PC_REG) || constReg(t, &base)) )
+      { known = TRUE ;
+        c = base * s ;
+        fprintf(out, " R[%d].v.i = %d ; R[%d].t = INT ;", r, c, r) ;
+      }
+      else fprintf(out, " d.i = %d ; MULI(%d,%d,d,%s) ;", s, r, t,
+                   (ip->iarg2.type == INT) ? "INT" : "FLOAT") ;
+      break;
+    default :   /* JLT .. JNE */
+      fprintf(out, " if (R[%d].v.i %s 0) {", r, cond[ip->iop - opJLT]) ;
+      known = emitEffAddr(ip, loc, &c) ;
+      fprintf(out, " R[7] = m ;") ;
+      emitGoto(known, c) ;
+      fprintf(out, " }") ;
+      break;
+  }
+  if ( (r == PC_REG) && (ip->iop != opHALT) && (ip->iop != opOUT)
+       && (ip->iop != opST) && (ip->iop < opJLT) )
+    emitGoto(known, c) ;
+  fprintf(out, "\n") ;
+} /* emitInstruction */
+
+/********************************************/
+void translate (void)
+{ int loc, hasIn ;
+  INSTRUCTION * ip ;
+  last = -1 ;
+  hasIn = FALSE ;
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+  { ip = &iMem[loc] ;
+    if ( (ip->iop != opHALT) || (ip->iarg1 != 0) || (ip->iarg2.type != INT)
+         || (ip->iarg2.attr.valint != 0) || (ip->iarg3 != 0) )
+      last = loc ;
+    if ( ip->iop == opIN ) hasIn = TRUE ;
+  }
+  fprintf(out, "/* %s translated by tm2c */\n", pgmName) ;
+  fprintf(out, prelude, iaddrSize, daddrSize, NO_REGS) ;
+  if ( hasIn ) fputs(inputPrelude, out) ;
+  fprintf(out, machinePrelude) ;
+  for (loc = 0 ; loc <= last ; loc++)
+    emitInstruction(loc) ;
+  fprintf(out, "  pc = %d ; goto dispatch ;\n", last + 1) ;
+  fprintf(out, "\ndispatch :\n  switch ( pc )\n  {") ;
+  for (loc = 0 ; loc <= last ; loc++)
+    fprintf(out, "%s case %d : goto L%d ;", (loc % 6 == 0) ? "\n   " : "", loc, loc) ;
+  fprintf(out, "\n  }\n  if ( (pc >= 0) && (pc < IADDR_SIZE) ) goto Lhalt ;\n"
+               "  goto imem ;\n") ;
+  fprintf(out, postlude) ;
+} /* translate */
+
+/********************************************/
+int main( int argc, char * argv[] )
+{ int loc ;
+  char * dot ;
+  outName[0] = '\0' ;
+  while ( (argc > 3) && (argv[1][0] == '-') )
+  { if ( strcmp(argv[1], "-o") == 0 )
+      strncpy(outName, argv[2], sizeof(outName)-1) ;
+    else if ( ! sizeOption(argv[1], argv[2]) ) break;
+    argv += 2 ;
+    argc -= 2 ;
+  }
+  if ( argc != 2 )
+  { printf("usage: %s [-o <output.c>] [-i n] [-d n] <filename>\n",argv[0]);
+    exit(1);
+  }
+  strncpy(pgmName,argv[1],sizeof(pgmName)-4) ;
+  if (strchr (pgmName, '.') == NULL)
+     strcat(pgmName,".tm");
+  pgm = fopen(pgmName,"r");
+  if (pgm == NULL)
+  { printf("file '%s' not found\n",pgmName);
+    exit(1);
+  }
+  if ( ! readInstructions ())
+    exit(1) ;
+  verifyInstructions () ;
+  for (loc = 0 ; loc < iaddrSize ; loc++)
+    if ( (opClass(iMem[loc].iop) == opclRR)
+         && ( (iMem[loc].iarg2.type != INT) || (iMem[loc].iarg2.attr.valint < 0)
+              || (iMem[loc].iarg2.attr.valint >= NO_REGS) ) )
+    { error("Bad second register", 0, loc) ;
+      exit(1) ;
+    }
+  if ( outName[0] == '\0' )
+  { strcpy(outName, pgmName) ;
+    dot = strrchr(outName, '.') ;
+    strcpy(dot, ".c") ;
+  }
+  out = fopen(outName, "w") ;
+  if ( out == NULL )
+  { printf("cannot write '%s'\n", outName) ;
+    exit(1) ;
+  }
+  translate () ;
+  fclose(out) ;
+  return 0 ;
+}
@@ -0,0 +1,302 @@
+/****************************************************/
+/* File: tmbatch.c                                  */
+/* Batches of TM runs: every program on every input */
+/* file, on a pool of threads sharing each decoded  */
+/* program, with jobs dealt out to work-stealing    */
+/* deques, and optionally run in SIMD lanes         */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libtm.h"
+#if defined(__unix__)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MAXWORKERS  256
+
+struct tmjob {
+      int program, input ;
+      int found ;          /* FALSE: the input could not be read */
+      STEPRESULT result ;
+      long count ;
+      TMOUTBUF out ;       /* what OUT wrote */
+   } ;
+
+/* a thread of the pool, with the jobs dealt to it: it
+ * runs them from the top of its deque, and others steal
+ * from the bottom
+ */
+struct tmworker {
+      TmBatch * batch ;
+      int index ;
+      int * deque ;        /* jobs not yet taken: top ... bottom-1 */
+      int top, bottom ;
+      TmMachine ** machine ;  /* by program, made on first use */
+#if defined(__unix__)
+      pthread_mutex_t lock ;
+      pthread_t thread ;
+#endif
+   } ;
+
+#if defined(__unix__)
+#define LOCK(w)     pthread_mutex_lock(&(w)->lock)
+#define UNLOCK(w)   pthread_mutex_unlock(&(w)->lock)
+#else
+#define LOCK(w)
+#define UNLOCK(w)
+#endif
+
+/* Function takeJobs takes up to max jobs of one
+ * program from the deque of w into j[], from the
+ * top if own and else from the bottom, returning
+ * how many: 0 if it is empty
+ */
+int takeJobs ( TMWORKER * w, int own, TMJOB * job, int max, int j[] )
+{ int n = 0 ;
+  LOCK(w) ;
+  while ( (n < max) && (w->top < w->bottom) )
+  { j[n] = own ? w->deque[w->top] : w->deque[w->bottom - 1] ;
+    if ( (n > 0) && (job[j[n]].program != job[j[0]].program) ) break ;
+    if ( own ) w->top++ ; else w->bottom-- ;
+    n++ ;
+  }
+  UNLOCK(w) ;
+  return n ;
+} /* takeJobs */
+
+/********************************************/
+char * readText ( const char * name, size_t * len )
+{ FILE * f = fopen(name, "rb") ;
+  char * text = NULL ;
+  size_t cap = 0, got ;
+  *len = 0 ;
+  if ( f == NULL ) return NULL ;
+  do
+  { if ( *len == cap )
+    { text = (char *) growArray(text, (int) cap, (int) (2 * cap + 4096), 1) ;
+      cap = 2 * cap + 4096 ;
+    }
+    got = fread(text + *len, 1, cap - *len, f) ;
+    *len += got ;
+  }
+  while ( got > 0 ) ;
+  fclose(f) ;
+  return text ;
+} /* readText */
+
+/* Procedure jobOut is the OUT hook of a job */
+void jobOut ( void * user, NUM v )
+{ bufferOut(&((TMJOB *) user)->out, v) ;
+} /* jobOut */
+
+/********************************************/
+TmBatch::TmBatch ( int workers, int dsize, int isize )
+{ if ( workers <= 0 )
+  {
+#if defined(__unix__)
+    workers = (int) sysconf(_SC_NPROCESSORS_ONLN) ;
+#else
+    workers = 1 ;
+#endif
+  }
+  if ( workers > MAXWORKERS ) workers = MAXWORKERS ;
+  if ( workers < 1 ) workers = 1 ;
+  nWorkers = workers ;
+  this->dsize = dsize ;
+  this->isize = isize ;
+  image = NULL ;
+  programName = inputName = NULL ;
+  nPrograms = nInputs = 0 ;
+  job = NULL ;
+  nJobs = 0 ;
+  nLanes = 1 ;
+  runBudget = 0 ;
+} /* TmBatch */
+
+/********************************************/
+void TmBatch::lanes ( int n )
+{ nLanes = (n < 1) ? 1 : (n > MAXLANES) ? MAXLANES : n ;
+} /* lanes */
+
+/********************************************/
+void TmBatch::budget ( long n )
+{ runBudget = (n < 0) ? 0 : n ;
+} /* budget */
+
+/********************************************/
+TmBatch::~TmBatch ()
+{ int i ;
+  for (i = 0 ; i < nJobs ; i++) free(job[i].out.text) ;
+  for (i = 0 ; i < nPrograms ; i++)
+  { delete image[i] ;
+    free(programName[i]) ;
+  }
+  for (i = 0 ; i < nInputs ; i++) free(inputName[i]) ;
+  free(job) ;
+  free(image) ;
+  free(programName) ;
+  free(inputName) ;
+} /* ~TmBatch */
+
+/********************************************/
+int TmBatch::addProgram ( const char * name )
+{ TmMachine * m = new TmMachine(dsize, isize) ;
+  if ( ! m->loadFile(name) )
+  { delete m ;
+    return FALSE ;
+  }
+  image = (TmMachine **) growArray(image, nPrograms, nPrograms + 1, sizeof(TmMachine *)) ;
+  programName = (char **) growArray(programName, nPrograms, nPrograms + 1, sizeof(char *)) ;
+  image[nPrograms] = m ;
+  programName[nPrograms++] = strdup(name) ;
+  return TRUE ;
+} /* addProgram */
+
+/********************************************/
+void TmBatch::addInput ( const char * name )
+{ inputName = (char **) growArray(inputName, nInputs, nInputs + 1, sizeof(char *)) ;
+  inputName[nInputs++] = strdup(name) ;
+} /* addInput */
+
+/********************************************/
+/* Function work is the body of a thread of */
+/* the pool: it runs jobs until neither its */
+/* deque nor any other has one left. Each   */
+/* job resets the machine of its program    */
+/* and reads its input file as IN values,   */
+/* stopping after the budget if any;        */
+/* with lanes, the jobs of a program taken  */
+/* together run at once in SIMD lanes       */
+/********************************************/
+void * TmBatch::work ( void * arg )
+{ TMWORKER * w = (TMWORKER *) arg ;
+  TmBatch * b = w->batch ;
+  TMJOB * p ;
+  TmMachine * m ;
+  char * text [MAXLANES] ;
+  size_t len [MAXLANES] ;
+  void * user [MAXLANES] ;
+  STEPRESULT result [MAXLANES] ;
+  long count [MAXLANES] ;
+  int i, n, k, j [MAXLANES] ;
+  for (;;)
+  { n = takeJobs(w, TRUE, b->job, b->nLanes, j) ;
+    for (i = 1 ; (n == 0) && (i < b->nPool) ; i++)
+      n = takeJobs(&b->worker[(w->index + i) % b->nPool], FALSE, b->job, b->nLanes, j) ;
+    if ( n == 0 ) return NULL ;
+    m = w->machine[b->job[j[0]].program] ;
+    if ( m == NULL ) m = w->machine[b->job[j[0]].program] = new TmMachine(b->image[b->job[j[0]].program]) ;
+    for (i = k = 0 ; i < n ; i++)
+    { p = &b->job[j[i]] ;
+      text[k] = readText(b->inputName[p->input], &len[k]) ;
+      if ( text[k] == NULL ) continue ;
+      p->found = TRUE ;
+      user[k++] = p ;
+    }
+    if ( k == 1 )
+    { p = (TMJOB *) user[0] ;
+      m->reset () ;
+      m->onOutput(jobOut, p) ;
+      openText(text[0], len[0]) ;
+      p->result = m->run (b->runBudget) ;
+      p->count = m->executed () ;
+    }
+    else if ( k > 1 )
+    { m->runLanes(k, text, len, jobOut, user, result, count, b->runBudget) ;
+      for (i = 0 ; i < k ; i++)
+      { p = (TMJOB *) user[i] ;
+        p->result = result[i] ;
+        p->count = count[i] ;
+      }
+    }
+    for (i = 0 ; i < k ; i++) free(text[i]) ;
+  }
+} /* work */
+
+/********************************************/
+int TmBatch::run ()
+{ TMWORKER pool [MAXWORKERS] ;
+  int i, j, w, failed ;
+  for (j = 0 ; j < nJobs ; j++) free(job[j].out.text) ;
+  free(job) ;
+  job = NULL ;
+  nJobs = nPrograms * nInputs ;
+  if ( nJobs == 0 ) return 0 ;
+  job = (TMJOB *) growArray(NULL, 0, nJobs, sizeof(TMJOB)) ;
+  for (j = 0 ; j < nJobs ; j++)
+  { job[j].program = j / nInputs ;
+    job[j].input = j % nInputs ;
+  }
+  /* each thread is dealt a run of jobs, mostly of one program */
+  worker = pool ;
+  nPool = (nJobs < nWorkers) ? nJobs : nWorkers ;
+  for (w = 0 ; w < nPool ; w++)
+  { pool[w].batch = this ;
+    pool[w].index = w ;
+    pool[w].deque = (int *) growArray(NULL, 0, nJobs / nPool + 1, sizeof(int)) ;
+    pool[w].top = pool[w].bottom = 0 ;
+    for (j = (int) ((long) nJobs * w / nPool) ; j < (long) nJobs * (w + 1) / nPool ; j++)
+      pool[w].deque[pool[w].bottom++] = j ;
+    pool[w].machine = (TmMachine **) growArray(NULL, 0, nPrograms, sizeof(TmMachine *)) ;
+#if defined(__unix__)
+    pthread_mutex_init(&pool[w].lock, NULL) ;
+#endif
+  }
+#if defined(__unix__)
+  for (w = 1 ; w < nPool ; w++)
+    if ( pthread_create(&pool[w].thread, NULL, work, &pool[w]) != 0 )
+      pool[w].thread = 0 ;   /* its jobs are stolen */
+#endif
+  work(&pool[0]) ;
+  for (w = 0 ; w < nPool ; w++)
+  {
+#if defined(__unix__)
+    if ( (w > 0) && (pool[w].thread != 0) ) pthread_join(pool[w].thread, NULL) ;
+    pthread_mutex_destroy(&pool[w].lock) ;
+#endif
+    for (i = 0 ; i < nPrograms ; i++) delete pool[w].machine[i] ;
+    free(pool[w].machine) ;
+    free(pool[w].deque) ;
+  }
+  worker = NULL ;
+  for (j = 0, failed = 0 ; j < nJobs ; j++)
+    if ( ! job[j].found || (job[j].result != srHALT) ) failed++ ;
+  return failed ;
+} /* run */
+
+/********************************************/
+STEPRESULT TmBatch::result ( int j )
+{ return ((j >= 0) && (j < nJobs)) ? job[j].result : srOKAY ;
+} /* result */
+
+/********************************************/
+long TmBatch::executed ( int j )
+{ return ((j >= 0) && (j < nJobs)) ? job[j].count : 0 ;
+} /* executed */
+
+/********************************************/
+const char * TmBatch::output ( int j, size_t * len )
+{ if ( (j < 0) || (j >= nJobs) )
+  { *len = 0 ;
+    return NULL ;
+  }
+  *len = job[j].out.len ;
+  return job[j].out.text ;
+} /* output */
+
+/********************************************/
+void TmBatch::report ( FILE * f )
+{ TMJOB * p ;
+  int j ;
+  for (j = 0 ; j < nJobs ; j++)
+  { p = &job[j] ;
+    fprintf(f, "%s < %s: ", programName[p->program], inputName[p->input]) ;
+    if ( ! p->found ) fprintf(f, "input not found\n") ;
+    else fprintf(f, "%s, %ld instructions\n",
+                 (p->result == srOKAY) ? "Budget spent" : stepResultTab[p->result], p->count) ;
+    if ( p->out.len > 0 ) fwrite(p->out.text, 1, p->out.len, f) ;
+  }
+} /* report */
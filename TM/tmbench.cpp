@@ -0,0 +1,329 @@
+/****************************************************/
+/* File: tmbench.c                                  */
+/* Benchmarks of the TM execution engines: each     */
+/* generated kernel is run on each engine a number  */
+/* of times, and the speeds are reported as JSON    */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include "libtm.h"
+
+#define   BENCH_DSIZE  8192      /* dMem of the machines */
+#define   STACK_DEPTH  32        /* temps pushed by the stack kernel */
+
+/******** vars ********/
+char text [16384] ;     /* the kernel being generated */
+int textLen ;
+int loc ;               /* its next instruction */
+
+/* Procedure emit adds instruction loc of a kernel */
+void emit ( const char * fmt, ... )
+{ va_list ap ;
+  textLen += sprintf(text + textLen, "%3d: ", loc++) ;
+  va_start(ap, fmt) ;
+  textLen += vsprintf(text + textLen, fmt, ap) ;
+  va_end(ap) ;
+  text[textLen++] = '\n' ;
+  text[textLen] = '\0' ;
+} /* emit */
+
+/********************************************/
+/* The kernels: each reads a count n and    */
+/* loops n times, executing about perUnit   */
+/* instructions each time, then OUTs what   */
+/* it computed                              */
+/********************************************/
+
+/* int arithmetic in registers */
+void genArith (void)
+{ int top ;
+  emit("IN  1,0,0") ;
+  emit("LDC 2,0(0)") ;
+  emit("LDC 3,1(0)") ;
+  emit("LDC 4,7(0)") ;
+  top = loc ;
+  emit("MUL 5,1,4") ;
+  emit("ADD 2,2,5") ;
+  emit("XOR 2,2,1") ;
+  emit("SUB 5,2,4") ;
+  emit("DIV 5,5,4") ;
+  emit("ADD 2,2,5") ;
+  emit("SUB 1,1,3") ;
+  emit("JGT 1,%d(7)", top - loc - 1) ;
+  emit("OUT 2,0,0") ;
+  emit("HALT 0,0,0") ;
+} /* genArith */
+
+/* compares and conditional jumps, half of them taken */
+void genBranch (void)
+{ int top ;
+  emit("IN  1,0,0") ;
+  emit("LDC 2,0(0)") ;
+  emit("LDC 3,1(0)") ;
+  emit("LDC 4,2(0)") ;
+  top = loc ;
+  emit("DIV 5,1,4") ;
+  emit("MUL 5,5,4") ;
+  emit("SUB 5,1,5") ;      /* n mod 2 */
+  emit("JEQ 5,3(7)") ;     /* even: to the SUB */
+  emit("ADD 2,2,3") ;
+  emit("JLT 2,5(7)") ;
+  emit("JGE 2,2(7)") ;
+  emit("SUB 2,2,3") ;
+  emit("JNE 5,2(7)") ;
+  emit("SUB 5,2,1") ;
+  emit("JGT 5,0(7)") ;
+  emit("SUB 1,1,3") ;
+  emit("JGT 1,%d(7)", top - loc - 1) ;
+  emit("OUT 2,0,0") ;
+  emit("HALT 0,0,0") ;
+} /* genBranch */
+
+/* LD/ST sweeps over 4096 words of dMem */
+void genMemory (void)
+{ int outer, inner ;
+  emit("IN  1,0,0") ;
+  emit("LDC 3,1(0)") ;
+  outer = loc ;
+  emit("LDC 2,4096(0)") ;
+  inner = loc ;
+  emit("LD  4,15(2)") ;
+  emit("LD  5,16(2)") ;
+  emit("ADD 4,4,5") ;
+  emit("ADD 4,4,2") ;
+  emit("ST  4,15(2)") ;
+  emit("SUB 2,2,3") ;
+  emit("JGT 2,%d(7)", inner - loc - 1) ;
+  emit("SUB 1,1,3") ;
+  emit("JGT 1,%d(7)", outer - loc - 1) ;
+  emit("LD  4,16(0)") ;
+  emit("OUT 4,0,0") ;
+  emit("HALT 0,0,0") ;
+} /* genMemory */
+
+/* arithmetic mixing floats and ints */
+void genFloat (void)
+{ int top ;
+  emit("IN  1,0,0") ;
+  emit("LDC 2,0(0)") ;
+  emit("LDC 3,1(0)") ;
+  emit("LDC 4,1.5(0)") ;
+  emit("LDC 5,0.25(0)") ;
+  top = loc ;
+  emit("ADD 2,2,4") ;
+  emit("MUL 6,1,5") ;
+  emit("SUB 2,2,6") ;
+  emit("DIV 6,2,4") ;
+  emit("ADD 2,6,3") ;
+  emit("SUB 1,1,3") ;
+  emit("JGT 1,%d(7)", top - loc - 1) ;
+  emit("OUT 2,0,0") ;
+  emit("HALT 0,0,0") ;
+} /* genFloat */
+
+/* temps pushed below mp and popped, as cgen does for
+ * deeply nested expressions
+ */
+void genStack (void)
+{ int top, k ;
+  emit("LD  6,0(0)") ;
+  emit("ST  0,0(0)") ;
+  emit("IN  1,0,0") ;
+  emit("LDC 3,1(0)") ;
+  emit("LDC 2,0(0)") ;
+  top = loc ;
+  for (k = 0 ; k < STACK_DEPTH ; k++) emit("ST  1,%d(6)", -k) ;
+  for (k = STACK_DEPTH - 1 ; k >= 0 ; k--)
+  { emit("LD  0,%d(6)", -k) ;
+    emit("ADD 2,2,0") ;
+  }
+  emit("SUB 1,1,3") ;
+  emit("JGT 1,%d(7)", top - loc - 1) ;
+  emit("OUT 2,0,0") ;
+  emit("HALT 0,0,0") ;
+} /* genStack */
+
+typedef struct {
+      const char * name ;
+      void (* gen) (void) ;
+      long perUnit ;          /* instructions a time round */
+   } KERNEL ;
+
+KERNEL kernels [] =
+  { { "arith",  genArith,  8 },
+    { "branch", genBranch, 11 },
+    { "memory", genMemory, 7 * 4096 + 3 },
+    { "float",  genFloat,  7 },
+    { "stack",  genStack,  3 * STACK_DEPTH + 2 }
+  } ;
+#define   NKERNELS  ((int) (sizeof(kernels) / sizeof(kernels[0])))
+
+/* the engines, each run on the bound machine */
+typedef enum {
+   engSTEP,     /* stepTM, one at a time, as the s(tep command */
+   engRUN,      /* runTM, the threaded interpreter */
+   engBUDGET,   /* runFor in slices, as TmMachine::run(budget) */
+   engDEBUG,    /* runDebug, as the g(o command */
+   engJIT,      /* runJIT */
+   engLANES,    /* runLanes, MAXLANES copies at once */
+   NENGINES
+   } ENGINE ;
+
+const char * engineName [NENGINES] =
+  { "step", "run", "budget", "debug", "jit", "lanes" } ;
+
+/********************************************/
+/* Function runEngine runs the bound        */
+/* machine on input as engine e does,       */
+/* storing what lane 0 wrote in o and the   */
+/* instructions executed by all in *icount  */
+/********************************************/
+STEPRESULT runEngine ( ENGINE e, char * input, TMOUTBUF * o, long * icount )
+{ STEPRESULT r = srOKAY ;
+  TMOUTBUF lane [MAXLANES] ;
+  char * in [MAXLANES] ;
+  size_t len [MAXLANES] ;
+  void * user [MAXLANES] ;
+  STEPRESULT result [MAXLANES] ;
+  long count [MAXLANES], n ;
+  int l ;
+  openText(input, strlen(input)) ;
+  *icount = 0 ;
+  switch ( e )
+  { case engSTEP :
+      do
+      { r = stepTM () ;
+        (*icount)++ ;
+      }
+      while ( r == srOKAY ) ;
+      break ;
+    case engRUN :    r = runTM (icount) ; break ;
+    case engBUDGET :
+      do
+      { r = runFor(&n, 10000) ;
+        *icount += n ;
+      }
+      while ( r == srOKAY ) ;
+      break ;
+    case engDEBUG :  r = runDebug (icount, 0) ; break ;
+    case engJIT :    r = runJIT (icount) ; break ;
+    case engLANES :
+      memset(lane, 0, sizeof(lane)) ;
+      for (l = 0 ; l < MAXLANES ; l++)
+      { in[l] = input ;
+        len[l] = strlen(input) ;
+        user[l] = (l == 0) ? (void *) o : (void *) &lane[l] ;
+      }
+      runLanes(MAXLANES, in, len, bufferOut, user, result, count, 0) ;
+      for (l = 0 ; l < MAXLANES ; l++)
+      { *icount += count[l] ;
+        free(lane[l].text) ;
+      }
+      r = result[0] ;
+      break ;
+    default : break ;
+  }
+  return r ;
+} /* runEngine */
+
+/********************************************/
+/* E X E C U T I O N   B E G I N S   H E R E */
+/********************************************/
+
+int main( int argc, char * argv[] )
+{ long size = 10000000, icount, n ;
+  int reps = 5, argi, k, e, i, first = TRUE ;
+  char * onlyKernel = NULL, * onlyEngine = NULL, * saveDir = NULL ;
+  char input [32], name [FILENAME_MAX] ;
+  double t, * ns, sum, mean, var, best ;
+  TMOUTBUF ref, o ;
+  TMCONTEXT * before ;
+  STEPRESULT r ;
+  FILE * f ;
+  for (argi = 1 ; (argi < argc) && (argv[argi][0] == '-') ; argi++)
+  { if ( (strcmp(argv[argi], "-r") == 0) && (argi + 1 < argc) )
+      reps = atoi(argv[++argi]) ;
+    else if ( (strcmp(argv[argi], "-n") == 0) && (argi + 1 < argc) )
+      size = atol(argv[++argi]) ;
+    else if ( (strcmp(argv[argi], "-k") == 0) && (argi + 1 < argc) )
+      onlyKernel = argv[++argi] ;
+    else if ( (strcmp(argv[argi], "-e") == 0) && (argi + 1 < argc) )
+      onlyEngine = argv[++argi] ;
+    else if ( (strcmp(argv[argi], "--save") == 0) && (argi + 1 < argc) )
+      saveDir = argv[++argi] ;
+    else break ;
+  }
+  if ( (argi != argc) || (reps < 1) || (size < 1) )
+  { printf("usage: %s [-r reps] [-n instructions] [-k kernel] [-e engine]"
+           " [--save dir]\n", argv[0]) ;
+    exit(1) ;
+  }
+  guardMemory = TRUE ;   /* for the JIT, as tm --jit */
+  ns = (double *) growArray(NULL, 0, reps, sizeof(double)) ;
+  memset(&ref, 0, sizeof(ref)) ;
+  memset(&o, 0, sizeof(o)) ;
+  printf("{\n  \"benchmark\": \"tmbench\",\n  \"repetitions\": %d,\n", reps) ;
+  printf("  \"results\": [") ;
+  for (k = 0 ; k < NKERNELS ; k++)
+  { if ( (onlyKernel != NULL) && (strcmp(onlyKernel, kernels[k].name) != 0) ) continue ;
+    textLen = loc = 0 ;
+    kernels[k].gen () ;
+    if ( saveDir != NULL )
+    { snprintf(name, sizeof(name), "%s/%s.tm", saveDir, kernels[k].name) ;
+      f = fopen(name, "w") ;
+      if ( f != NULL )
+      { fputs(text, f) ;
+        fclose(f) ;
+      }
+    }
+    TmMachine m(BENCH_DSIZE) ;
+    if ( ! m.loadText(text, textLen) ) exit(1) ;
+    n = size / kernels[k].perUnit ;
+    sprintf(input, "%ld\n", (n > 0) ? n : 1) ;
+    ref.len = 0 ;
+    /* the interpreter's output is the one the others must match */
+    m.reset () ;
+    m.onOutput(bufferOut, &ref) ;
+    before = m.bind () ;
+    runEngine(engRUN, input, &ref, &icount) ;
+    bindContext(before) ;
+    for (e = 0 ; e < NENGINES ; e++)
+    { if ( (onlyEngine != NULL) && (strcmp(onlyEngine, engineName[e]) != 0) ) continue ;
+      for (i = 0 ; i < reps ; i++)
+      { o.len = 0 ;
+        m.reset () ;
+        m.onOutput(bufferOut, &o) ;
+        before = m.bind () ;
+        t = wallClock () ;
+        r = runEngine((ENGINE) e, input, &o, &icount) ;
+        t = wallClock () - t ;
+        bindContext(before) ;
+        ns[i] = t * 1e9 / (icount > 0 ? icount : 1) ;
+      }
+      for (i = 0, sum = 0, best = ns[0] ; i < reps ; i++)
+      { sum += ns[i] ;
+        if ( ns[i] < best ) best = ns[i] ;
+      }
+      mean = sum / reps ;
+      for (i = 0, var = 0 ; i < reps ; i++) var += (ns[i] - mean) * (ns[i] - mean) ;
+      var = (reps > 1) ? var / (reps - 1) : 0 ;
+      printf("%s\n    { \"kernel\": ", first ? "" : ",") ;
+      jsonString(stdout, (char *) kernels[k].name) ;
+      printf(", \"engine\": ") ;
+      jsonString(stdout, (char *) engineName[e]) ;
+      printf(", \"result\": ") ;
+      jsonString(stdout, stepResultTab[r]) ;
+      printf(",\n      \"instructions\": %ld, \"instructions_per_second\": %.0f,\n"
+             "      \"ns_per_instruction\": %.4f, \"min_ns_per_instruction\": %.4f,"
+             " \"variance\": %.6f,\n      \"output_matches\": %s }",
+             icount, 1e9 / mean, mean, best, var,
+             ((o.len == ref.len) && (memcmp(o.text, ref.text, o.len) == 0)) ? "true" : "false") ;
+      first = FALSE ;
+    }
+  }
+  printf("\n  ]\n}\n") ;
+  return 0 ;
+} /* main */
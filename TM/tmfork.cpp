@@ -0,0 +1,124 @@
+/****************************************************/
+/* File: tmfork.c                                   */
+/* Fork server: a program loaded and decoded once,  */
+/* then run on each requested input in a child      */
+/* process of its own, sharing the parent's pages   */
+/* copy-on-write, under resource limits             */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include "libtm.h"
+#if defined(__unix__)
+#include <signal.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
+
+/* Procedure addText adds len bytes of text to p */
+static void addText ( TMOUTBUF * p, const char * text, size_t len )
+{ if ( p->len + len > p->cap )
+  { p->text = (char *) growArray(p->text, (int) p->cap, (int) (2 * p->cap + len), 1) ;
+    p->cap = 2 * p->cap + len ;
+  }
+  memcpy(p->text + p->len, text, len) ;
+  p->len += len ;
+} /* addText */
+
+/********************************************/
+/* Function runOne runs m on input and      */
+/* writes its report to f as TmBatch does,  */
+/* returning the result; m is left dirty.   */
+/* The report is built in a buffer and      */
+/* written once at the end, so a run killed */
+/* before then writes none of it            */
+/********************************************/
+STEPRESULT runOne ( TmMachine * m, const char * name, const char * input,
+                    long budget, FILE * f )
+{ TMOUTBUF o, report ;
+  STEPRESULT r ;
+  char * text, line [1200] ;
+  size_t len ;
+  memset(&o, 0, sizeof(o)) ;
+  memset(&report, 0, sizeof(report)) ;
+  text = readText(input, &len) ;
+  if ( text == NULL )
+  { r = srNO_INPUT ;
+    snprintf(line, sizeof(line), "%s < %s: input not found\n", name, input) ;
+  }
+  else
+  { m->onOutput(bufferOut, &o) ;
+    openText(text, len) ;
+    r = m->run(budget) ;
+    m->onOutput(NULL, NULL) ;
+    snprintf(line, sizeof(line), "%s < %s: %s, %ld instructions\n", name, input,
+             (r == srOKAY) ? "Budget spent" : stepResultTab[r], m->executed ()) ;
+  }
+  addText(&report, line, strlen(line)) ;
+  if ( o.len > 0 ) addText(&report, o.text, o.len) ;
+  fwrite(report.text, 1, report.len, f) ;
+  free(report.text) ;
+  free(o.text) ;
+  free(text) ;
+  return r ;
+} /* runOne */
+
+/********************************************/
+int forkServe ( TmMachine * m, const char * name, FILE * requests,
+                long budget, long cpu )
+{ char line [1024], * input, * end ;
+  int failed = 0 ;
+#if defined(__unix__)
+  struct rlimit lim ;
+  pid_t pid, w ;
+  int status ;
+#endif
+  while ( fgets(line, sizeof(line), requests) != NULL )
+  { for (input = line ; isspace((unsigned char) *input) ; input++) ;
+    for (end = input + strlen(input) ; (end > input) && isspace((unsigned char) end[-1]) ; end--) ;
+    *end = '\0' ;
+    if ( *input == '\0' ) continue ;
+#if defined(__unix__)
+    fflush(stdout) ;
+    pid = fork () ;
+    if ( pid == 0 )
+    { /* the child: m is still as loaded, never run */
+      if ( cpu > 0 )
+      { lim.rlim_cur = (rlim_t) cpu ;
+        lim.rlim_max = (rlim_t) cpu + 1 ;
+        setrlimit(RLIMIT_CPU, &lim) ;
+      }
+      lim.rlim_cur = lim.rlim_max = 0 ;
+      setrlimit(RLIMIT_CORE, &lim) ;
+      status = (runOne(m, name, input, budget, stdout) == srHALT) ? 0 : 1 ;
+      fflush(stdout) ;
+      _exit(status) ;
+    }
+    if ( pid < 0 )
+    { printf("%s < %s: cannot fork\n", name, input) ;
+      failed++ ;
+      continue ;
+    }
+    while ( ((w = waitpid(pid, &status, 0)) < 0) && (errno == EINTR) ) ;
+    if ( w < 0 )
+    { printf("%s < %s: cannot wait: %s\n", name, input, strerror(errno)) ;
+      failed++ ;
+    }
+    else if ( WIFSIGNALED(status) )
+    { printf("%s < %s: %s\n", name, input, strsignal(WTERMSIG(status))) ;
+      failed++ ;
+    }
+    else if ( WEXITSTATUS(status) != 0 ) failed++ ;
+#else
+    /* no processes to fork: each runs in turn, reset */
+    if ( runOne(m, name, input, budget, stdout) != srHALT ) failed++ ;
+    m->reset () ;
+#endif
+  }
+  fflush(stdout) ;
+  return failed ;
+} /* forkServe */
@@ -0,0 +1,478 @@
+/****************************************************/
+/* File: tmmain.c                                   */
+/* Command loop and options of the TM ("Tiny        */
+/* Machine") simulator, a front end over one        */
+/* TmMachine                                        */
+/* Compiler Construction: Principles and Practice   */
+/* Kenneth C. Louden                                */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include "libtm.h"
+
+/******** vars ********/
+int iloc = 0 ;
+int dloc = 0 ;
+int icountflag = FALSE;
+int done  ;
+long totalCount = 0 ;   /* instructions executed since the clear */
+
+/********************************************/
+int doCommand (void)
+{ char cmd;
+  int stepcnt=0, i, n;
+  int printcnt;
+  int stepResult;
+  long icount, limit = 0;
+  NUM v;
+  do
+  { printf ("Enter command: ");
+    fflush (stdout);
+    if (! getLine ()) return FALSE;
+    inCol = 0;
+  }
+  while (! getWord ());
+
+  cmd = word[0] ;
+  switch ( cmd )
+  { case 't' :
+    /***********************************/
+      traceflag = ! traceflag ;
+      printf("Tracing now ");
+      if ( traceflag ) printf("on.\n"); else printf("off.\n");
+      break;
+
+    case 'h' :
+    /***********************************/
+      printf("Commands are:\n");
+      printf("   s(tep <n>      "\
+             "Execute n (default 1) TM instructions\n");
+      printf("   g(o <n>        "\
+             "Execute TM instructions until HALT (at most n)\n");
+      printf("   b(reak <loc>   "\
+             "Toggle a breakpoint at iMem loc (none: list them)\n");
+      printf("   w(atch <loc>   "\
+             "Toggle a watchpoint on dMem loc (none: list them)\n");
+      printf("   r(egs          "\
+             "Print the contents of the registers\n");
+      printf("   i(Mem <b <n>>  "\
+             "Print n iMem locations starting at b\n");
+      printf("   d(Mem <b <n>>  "\
+             "Print n dMem locations starting at b\n");
+      printf("   t(race         "\
+             "Toggle instruction trace\n");
+      printf("   p(rint         "\
+             "Toggle print of total instructions executed"\
+             " ('go' only)\n");
+      printf("   c(lear         "\
+             "Reset simulator for new execution of program\n");
+      printf("   k(eep <file>   "\
+             "Write a snapshot of the machine to file\n");
+      printf("   l(oad <file>   "\
+             "Resume from the snapshot in file\n");
+      printf("   h(elp          "\
+             "Cause this list of commands to be printed\n");
+      printf("   q(uit          "\
+             "Terminate the simulation\n");
+      break;
+
+    case 'p' :
+    /***********************************/
+      icountflag = ! icountflag ;
+      printf("Printing instruction count now ");
+      if ( icountflag ) printf("on.\n"); else printf("off.\n");
+      break;
+
+    case 's' :
+    /***********************************/
+      if ( atEOL ())  stepcnt = 1;
+      else if ( getNum ())  stepcnt = abs(num);
+      else   printf("Step count?\n");
+      break;
+
+    case 'g' :
+    /***********************************/
+      stepcnt = 1 ;
+      if ( getNum ()) limit = abs(num) ;
+      if ( ! atEOL ())
+      { printf("Instruction count?\n");
+        stepcnt = 0 ;
+      }
+      break;
+
+    case 'b' :
+    /***********************************/
+      if ( atEOL ())
+      { for (i = 0; (breakAt != NULL) && (i < iaddrSize); i++)
+          if ( breakAt[i] ) writeInstruction(i) ;
+      }
+      else if ( getNum () && (num >= 0) && (num < iaddrSize) )
+      { if ( breakAt == NULL ) breakAt = (char *) mapZero(iaddrSize + 1) ;
+        breakAt[num] = ! breakAt[num] ;
+        nBreaks += breakAt[num] ? 1 : -1 ;
+        printf("Breakpoint at %d now ", num);
+        if ( breakAt[num] ) printf("on.\n"); else printf("off.\n");
+      }
+      else printf("Breakpoint location?\n");
+      break;
+
+    case 'w' :
+    /***********************************/
+      if ( atEOL ())
+      { for (i = 0; (watchAt != NULL) && (i < daddrSize); i++)
+          if ( watchAt[i] ) printf("%5d\n", i) ;
+      }
+      else if ( getNum () && (num >= 0) && (num < daddrSize) )
+      { if ( watchAt == NULL ) watchAt = (char *) mapZero(daddrSize) ;
+        watchAt[num] = ! watchAt[num] ;
+        nWatches += watchAt[num] ? 1 : -1 ;
+        printf("Watchpoint at %d now ", num);
+        if ( watchAt[num] ) printf("on.\n"); else printf("off.\n");
+      }
+      else printf("Watchpoint location?\n");
+      break;
+
+    case 'r' :
+    /***********************************/
+      /* registers 8 and up only once a program has set one */
+      for (n = NO_REGS; (n > 8) && (regVal[n-1].valint == 0); n--) ;
+      for (i = 0; i < ((n + 3) & ~3); i++)
+      {
+        printf("%1d: ", i);
+        v = getReg(i);
+        if (v.type == INT)
+          printf("%4d    ", v.attr.valint);
+        else
+          printf("%.2f    ", v.attr.valfloat);
+        if ( (i % 4) == 3 ) printf ("\n");
+      }
+      break;
+
+    case 'i' :
+    /***********************************/
+      printcnt = 1 ;
+      if ( getNum ())
+      { iloc = num ;
+        if ( getNum ()) printcnt = num ;
+      }
+      if ( ! atEOL ())
+        printf ("Instruction locations?\n");
+      else
+      { while ((iloc >= 0) && (iloc < iaddrSize)
+                && (printcnt > 0) )
+        { writeInstruction(iloc);
+          iloc++ ;
+          printcnt-- ;
+        }
+      }
+      break;
+
+    case 'd' :
+    /***********************************/
+      printcnt = 1 ;
+      if ( getNum  ())
+      { dloc = num ;
+        if ( getNum ()) printcnt = num ;
+      }
+      if ( ! atEOL ())
+        printf("Data locations?\n");
+      else
+      { while ((dloc >= 0) && (dloc < daddrSize)
+                  && (printcnt > 0))
+        { printf("%5d: ",dloc);
+          v = getMem(dloc);
+          if (v.type == INT) printf("%5d\n", v.attr.valint);
+          else printf("%.4f\n", v.attr.valfloat);
+          dloc++;
+          printcnt--;
+        }
+      }
+      break;
+
+    case 'c' :
+    /***********************************/
+      iloc = 0;
+      dloc = 0;
+      stepcnt = 0;
+      totalCount = 0;
+      clearMachine();
+      break;
+
+    case 'k' :
+    case 'l' :
+    /***********************************/
+      if ( ! nonBlank ()) printf("Snapshot file?\n");
+      else if ( cmd == 'k' )
+      { if ( saveSnapshot(in_Line + inCol, totalCount, FALSE) )
+          printf("Snapshot written to %s\n", in_Line + inCol);
+      }
+      else if ( loadSnapshot(in_Line + inCol, &totalCount) )
+        printf("Resumed at %ld instructions\n", totalCount);
+      break;
+
+    case 'q' : return FALSE;  /* break; */
+
+    default : printf("Command %c unknown.\n", cmd); break;
+  }  /* case */
+  stepResult = srOKAY;
+  if ( stepcnt > 0 )
+  { if ( cmd == 'g' )
+    { stepResult = runDebug (&icount, limit);
+      totalCount += icount;
+      if ( icountflag )
+        printf("Number of instructions executed = %ld\n",icount);
+      if ( stepResult == srWATCH )
+      { v = getMem(watchHit);
+        if (v.type == INT) printf("%5d: %5d\n", watchHit, v.attr.valint);
+        else printf("%5d: %.4f\n", watchHit, v.attr.valfloat);
+      }
+    }
+    else
+    { while ((stepcnt > 0) && (stepResult == srOKAY))
+      { iloc = regVal[PC_REG].valint ;
+        if ( traceflag ) writeInstruction( iloc ) ;
+        stepResult = stepTM ();
+        totalCount++ ;
+        stepcnt-- ;
+      }
+    }
+    printf( "%s\n",stepResultTab[stepResult] );
+  }
+  return TRUE;
+} /* doCommand */
+
+
+/********************************************/
+/* Function runSnapshots runs as runTM      */
+/* does, writing a snapshot to name about   */
+/* every every instructions if every > 0,   */
+/* and at the next jump after a SIGUSR1;    */
+/* *icount goes on from where it is         */
+/********************************************/
+#define   SNAPCHUNK  (1L << 20)  /* instructions between looks at SIGUSR1 */
+
+volatile sig_atomic_t snapWanted = FALSE ;
+
+void wantSnapshot ( int sig )
+{ snapWanted = TRUE ;
+} /* wantSnapshot */
+
+STEPRESULT runSnapshots ( long * icount, char * name, long every, int forked )
+{ STEPRESULT result ;
+  long n, since = 0 ;
+#if defined(SIGUSR1)
+  signal(SIGUSR1, wantSnapshot) ;
+#endif
+  do
+  { n = ((every > 0) && (every - since < SNAPCHUNK)) ? every - since : SNAPCHUNK ;
+    result = runFor(&n, n) ;
+    *icount += n ;
+    since += n ;
+    if ( (result == srOKAY) && (snapWanted || ((every > 0) && (since >= every))) )
+    { flushOut () ;
+      saveSnapshot(name, *icount, forked) ;
+      snapWanted = FALSE ;
+      since = 0 ;
+    }
+  }
+  while ( result == srOKAY ) ;
+  waitSnapshot () ;
+  return result ;
+} /* runSnapshots */
+
+/********************************************/
+/* Function runBatch runs tm --batch: the   */
+/* programs of argv up to "--" on each of   */
+/* the input files after it, with workers   */
+/* threads and lanes of SIMD lanes, each    */
+/* job stopping after budget instructions   */
+/* if budget > 0, and reports on standard   */
+/* output                                   */
+/********************************************/
+int runBatch ( int argc, char * argv[], int workers, int lanes, long budget )
+{ TmBatch batch(workers, daddrSize, iaddrSize) ;
+  char name[120] ;
+  int i ;
+  batch.lanes(lanes) ;
+  batch.budget(budget) ;
+  for (i = 0 ; (i < argc) && (strcmp(argv[i], "--") != 0) ; i++)
+  { strncpy(name, argv[i], sizeof(name)-4) ;
+    name[sizeof(name)-4] = '\0' ;
+    if (strchr (name, '.') == NULL)
+       strcat(name, ".tm") ;
+    if ( ! batch.addProgram(name) ) return 1 ;
+  }
+  for (i++ ; i < argc ; i++) batch.addInput(argv[i]) ;
+  i = batch.run () ;
+  batch.report(stdout) ;
+  return (i == 0) ? 0 : 1 ;
+} /* runBatch */
+
+/********************************************/
+/* E X E C U T I O N   B E G I N S   H E R E */
+/********************************************/
+
+int main( int argc, char * argv[] )
+{ int runflag = FALSE;
+  int jitflag = FALSE;
+  int batchflag = FALSE;
+  int workers = 0;
+  int lanes = 1;
+  int forkflag = FALSE;
+  long budget = 0, cpu = 0;
+  char * servePath = NULL, * submitPath = NULL;
+  int cacheSize = 16;
+  char * snapName = NULL, * resumeName = NULL;
+  long every = 0;
+  int snapFork = FALSE;
+  int profflag = FALSE;
+  char * traceName = NULL;
+  long traceRecords = TRACE_RING;
+  int argi;
+  long icount;
+  STEPRESULT stepResult;
+  TmMachine * machine;
+  for (argi = 1 ; (argi < argc) && (argv[argi][0] == '-') ; argi++)
+  { if (strcmp(argv[argi], "--run") == 0) runflag = TRUE;
+    else if (strcmp(argv[argi], "--jit") == 0) runflag = jitflag = guardMemory = TRUE;
+    else if (strcmp(argv[argi], "--profile") == 0) runflag = profflag = TRUE;
+    else if (strcmp(argv[argi], "--batch") == 0) batchflag = TRUE;
+    else if ((strcmp(argv[argi], "-j") == 0) && (argi + 1 < argc))
+      workers = atoi(argv[++argi]);
+    else if (strcmp(argv[argi], "--fork-server") == 0) forkflag = TRUE;
+    else if ((strcmp(argv[argi], "--serve") == 0) && (argi + 1 < argc))
+      servePath = argv[++argi];
+    else if ((strcmp(argv[argi], "--submit") == 0) && (argi + 1 < argc))
+      submitPath = argv[++argi];
+    else if ((strcmp(argv[argi], "--snapshot") == 0) && (argi + 1 < argc))
+    { runflag = TRUE;
+      snapName = argv[++argi];
+    }
+    else if ((strcmp(argv[argi], "--every") == 0) && (argi + 1 < argc))
+      every = strtol(argv[++argi], NULL, 10);
+    else if (strcmp(argv[argi], "--fork-snapshot") == 0) snapFork = TRUE;
+    else if ((strcmp(argv[argi], "--resume") == 0) && (argi + 1 < argc))
+      resumeName = argv[++argi];
+    else if ((strcmp(argv[argi], "--cache") == 0) && (argi + 1 < argc))
+      cacheSize = atoi(argv[++argi]);
+    else if ((strcmp(argv[argi], "--budget") == 0) && (argi + 1 < argc))
+      budget = strtol(argv[++argi], NULL, 10);
+    else if ((strcmp(argv[argi], "--cpu") == 0) && (argi + 1 < argc))
+      cpu = strtol(argv[++argi], NULL, 10);
+    else if ((strcmp(argv[argi], "--lanes") == 0) && (argi + 1 < argc))
+    { lanes = atoi(argv[++argi]);
+      if ((lanes < 1) || (lanes > MAXLANES))
+      { printf("--lanes must be 1 to %d\n", MAXLANES);
+        exit(1);
+      }
+    }
+    else if ((strcmp(argv[argi], "--trace") == 0) && (argi + 1 < argc))
+    { runflag = TRUE;
+      traceName = argv[++argi];
+    }
+    else if ((strcmp(argv[argi], "--out") == 0) && (argi + 1 < argc))
+    { argi++;
+      if (strcmp(argv[argi], "text") == 0) outFormat = outTEXT;
+      else if (strcmp(argv[argi], "plain") == 0) outFormat = outPLAIN;
+      else if (strcmp(argv[argi], "binary") == 0) outFormat = outBINARY;
+      else
+      { printf("--out must be text, plain or binary\n");
+        exit(1);
+      }
+    }
+    else if ((strcmp(argv[argi], "--ring") == 0) && (argi + 1 < argc))
+    { long n = strtol(argv[++argi], NULL, 10);
+      if ((n < 1) || (n > (1L << 30)))
+      { printf("--ring must be 1 to %ld\n", 1L << 30);
+        exit(1);
+      }
+      for (traceRecords = 1 ; traceRecords < n ; traceRecords <<= 1) ;
+    }
+    else if (strcmp(argv[argi], "-p") == 0) icountflag = TRUE;
+    else if (strcmp(argv[argi], "--hugepages") == 0) hugePages = TRUE;
+    else if ((argi + 1 < argc) && sizeOption(argv[argi], argv[argi+1])) argi++;
+    else break;
+  }
+  if (batchflag && (argi < argc) && (strcmp(argv[argi], "--") != 0))
+    return runBatch(argc - argi, argv + argi, workers, lanes, budget);
+  if ((servePath != NULL) && (argi == argc))
+    return serveTM(servePath, cacheSize, budget, daddrSize, iaddrSize);
+  if ((submitPath != NULL) && (argi == argc - 2))
+    return submitTM(submitPath, argv[argi], argv[argi+1], budget);
+  if (batchflag || (servePath != NULL) || (submitPath != NULL) || (argi != argc - 1))
+  { printf("usage: %s [--run [--budget n] | --jit | --profile | --trace file [--ring n]]"
+           " [--out text|plain|binary] [-p] [-i n] [-d n] [--hugepages]"
+           " <filename>\n",argv[0]);
+    printf("       %s --snapshot file [--every n] [--fork-snapshot] [--resume file]"
+           " [--out text|plain|binary] [-p] [-i n] [-d n] <filename>\n",argv[0]);
+    printf("       %s --batch [-j n] [--lanes n] [--budget n] [--out text|plain|binary] [-i n] [-d n]"
+           " <filename>... -- <input>...\n",argv[0]);
+    printf("       %s --fork-server [--budget n] [--cpu s] [--out text|plain|binary]"
+           " [-i n] [-d n] <filename> < requests\n",argv[0]);
+    printf("       %s --serve <socket> [--cache n] [--budget n] [--out text|plain|binary]"
+           " [-i n] [-d n]\n",argv[0]);
+    printf("       %s --submit <socket> [--budget n] <filename> <input>\n",argv[0]);
+    exit(1);
+  }
+  /* only --run of the single-program modes stops on a budget */
+  if ((budget != 0) && ! forkflag
+      && ! (runflag && ! jitflag && ! profflag && (traceName == NULL) && (snapName == NULL)))
+  { printf("--budget applies only to --run, --batch, --fork-server, --serve and --submit\n");
+    exit(1);
+  }
+  strncpy(pgmName,argv[argi],sizeof(pgmName)-4) ;
+  if (strchr (pgmName, '.') == NULL)
+     strcat(pgmName,".tm");
+
+  /* read the program; the machine then stays bound */
+  machine = new TmMachine(daddrSize, iaddrSize);
+  machine->messages(stdout);
+  if ( ! machine->loadFile(pgmName))
+         exit(1) ;
+  /* --fork-server: each input named on standard input runs in a child */
+  if ( forkflag )
+  { machine->messages(NULL);
+    return (forkServe(machine, pgmName, stdin, budget, cpu) == 0) ? 0 : 1;
+  }
+  machine->bind () ;
+  if ( (resumeName != NULL) && ! loadSnapshot(resumeName, &totalCount) )
+    exit(1) ;
+  /* --run, --jit, --profile, --trace: execute to completion, or for
+   * --run to the budget, without the command loop; profiles and
+   * traces are taken on the interpreter
+   */
+  if ( runflag )
+  { openInput () ;
+    batchOutput = TRUE ;
+    if ( outFormat == outBINARY ) msgOut = stderr ;
+    if ( profflag ) stepResult = runProfile (&icount);
+    else if ( traceName != NULL )
+      stepResult = runTrace (&icount, traceName, traceRecords);
+    else if ( snapName != NULL )
+    { icount = totalCount;
+      stepResult = runSnapshots (&icount, snapName, every, snapFork);
+    }
+    else
+    { stepResult = jitflag ? runJIT (&icount) : runFor (&icount, budget);
+      icount += totalCount;
+    }
+    flushOut () ;
+    if ( icountflag )
+      fprintf(msgOut, "Number of instructions executed = %ld\n",icount);
+    fprintf(msgOut, "%s\n",
+            (stepResult == srOKAY) ? "Budget spent" : stepResultTab[stepResult] );
+    return (stepResult == srHALT) ? 0 : 1;
+  }
+  /* switch input file to terminal */
+  /* reset( input ); */
+  /* read-eval-print */
+  printf("TM  simulation (enter h for help)...\n");
+  do
+     done = ! doCommand ();
+  while (! done );
+  printf("Simulation done.\n");
+  return 0;
+}
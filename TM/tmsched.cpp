@@ -0,0 +1,196 @@
+/****************************************************/
+/* File: tmsched.c                                  */
+/* Cooperative scheduler of TmMachines: sessions    */
+/* run round robin a quantum at a time, and one at  */
+/* an IN with no input queued waits off the run     */
+/* queue instead of blocking the thread             */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libtm.h"
+
+struct tmsession {
+      TmMachine * m ;
+      TMSTATE state ;
+      STEPRESULT result ;
+      int closed ;      /* no more input will be fed */
+      NUM * in ;        /* ring of queued input */
+      int inHead, inLen, inCap ;
+   } ;
+
+/********************************************/
+void * growArray ( void * p, int n, int m, size_t size )
+{ p = realloc(p, (size_t) m * size) ;
+  if ( p == NULL )
+  { printf("out of memory\n") ;
+    exit(1) ;
+  }
+  memset((char *) p + (size_t) n * size, 0, (size_t) (m - n) * size) ;
+  return p ;
+} /* growArray */
+
+/********************************************/
+/* Function sessionIn is the IN hook of a   */
+/* session: the next queued value, or FALSE */
+/* to stop the run at the IN                */
+/********************************************/
+int sessionIn ( void * user, NUM * v )
+{ TMSESSION * p = (TMSESSION *) user ;
+  if ( p->inLen == 0 ) return FALSE ;
+  *v = p->in[p->inHead] ;
+  p->inHead = (p->inHead + 1) % p->inCap ;
+  p->inLen-- ;
+  return TRUE ;
+} /* sessionIn */
+
+/********************************************/
+TmScheduler::TmScheduler ( long quantum )
+{ this->quantum = (quantum > 0) ? quantum : 1 ;
+  session = NULL ;
+  runQueue = NULL ;
+  nSessions = maxSessions = 0 ;
+  head = nReady = 0 ;
+} /* TmScheduler */
+
+/********************************************/
+TmScheduler::~TmScheduler ()
+{ int s ;
+  for (s = 0 ; s < nSessions ; s++)
+    if ( session[s] != NULL ) remove(s) ;
+  free(session) ;
+  free(runQueue) ;
+} /* ~TmScheduler */
+
+/********************************************/
+/* Procedure makeReady puts session s at    */
+/* the tail of the run queue                */
+/********************************************/
+void TmScheduler::makeReady ( int s )
+{ runQueue[(head + nReady) % maxSessions] = s ;
+  nReady++ ;
+  session[s]->state = tmREADY ;
+} /* makeReady */
+
+/********************************************/
+int TmScheduler::add ( TmMachine * m )
+{ TMSESSION * p ;
+  int s, i, * q ;
+  for (s = 0 ; (s < nSessions) && (session[s] != NULL) ; s++) ;
+  if ( s == maxSessions )
+  { /* the run queue is laid out again from its head */
+    q = (int *) growArray(NULL, 0, 2 * maxSessions + 16, sizeof(int)) ;
+    for (i = 0 ; i < nReady ; i++) q[i] = runQueue[(head + i) % maxSessions] ;
+    free(runQueue) ;
+    runQueue = q ;
+    head = 0 ;
+    session = (TMSESSION **) growArray(session, maxSessions,
+                                       2 * maxSessions + 16, sizeof(TMSESSION *)) ;
+    maxSessions = 2 * maxSessions + 16 ;
+  }
+  if ( s == nSessions ) nSessions++ ;
+  p = (TMSESSION *) growArray(NULL, 0, 1, sizeof(TMSESSION)) ;
+  p->m = m ;
+  p->result = srOKAY ;
+  session[s] = p ;
+  m->onInput(sessionIn, p) ;
+  makeReady(s) ;
+  return s ;
+} /* add */
+
+/********************************************/
+void TmScheduler::feed ( int s, NUM v )
+{ TMSESSION * p ;
+  NUM * in ;
+  int i ;
+  if ( (s < 0) || (s >= nSessions) || (session[s] == NULL) ) return ;
+  p = session[s] ;
+  if ( (p->state == tmDONE) || p->closed ) return ;
+  if ( p->inLen == p->inCap )
+  { in = (NUM *) growArray(NULL, 0, 2 * p->inCap + 8, sizeof(NUM)) ;
+    for (i = 0 ; i < p->inLen ; i++) in[i] = p->in[(p->inHead + i) % p->inCap] ;
+    free(p->in) ;
+    p->in = in ;
+    p->inHead = 0 ;
+    p->inCap = 2 * p->inCap + 8 ;
+  }
+  p->in[(p->inHead + p->inLen) % p->inCap] = v ;
+  p->inLen++ ;
+  if ( p->state == tmWAITING ) makeReady(s) ;
+} /* feed */
+
+/********************************************/
+void TmScheduler::close ( int s )
+{ TMSESSION * p ;
+  if ( (s < 0) || (s >= nSessions) || (session[s] == NULL) ) return ;
+  p = session[s] ;
+  p->closed = TRUE ;
+  if ( p->state == tmWAITING )
+  { p->state = tmDONE ;
+    p->result = srNO_INPUT ;
+  }
+} /* close */
+
+/********************************************/
+int TmScheduler::runSlice ()
+{ TMSESSION * p ;
+  STEPRESULT r ;
+  int s ;
+  if ( nReady == 0 ) return -1 ;
+  s = runQueue[head] ;
+  head = (head + 1) % maxSessions ;
+  nReady-- ;
+  p = session[s] ;
+  r = p->m->run(quantum) ;
+  if ( r == srOKAY ) makeReady(s) ;
+  else if ( (r == srNO_INPUT) && ! p->closed ) p->state = tmWAITING ;
+  else
+  { p->state = tmDONE ;
+    p->result = r ;
+  }
+  return s ;
+} /* runSlice */
+
+/********************************************/
+long TmScheduler::run ()
+{ long slices = 0 ;
+  while ( runSlice () >= 0 ) slices++ ;
+  return slices ;
+} /* run */
+
+/********************************************/
+TMSTATE TmScheduler::state ( int s )
+{ if ( (s < 0) || (s >= nSessions) || (session[s] == NULL) ) return tmDONE ;
+  return session[s]->state ;
+} /* state */
+
+/********************************************/
+STEPRESULT TmScheduler::result ( int s )
+{ if ( (s < 0) || (s >= nSessions) || (session[s] == NULL) ) return srOKAY ;
+  return session[s]->result ;
+} /* result */
+
+/********************************************/
+TmMachine * TmScheduler::machine ( int s )
+{ if ( (s < 0) || (s >= nSessions) || (session[s] == NULL) ) return NULL ;
+  return session[s]->m ;
+} /* machine */
+
+/********************************************/
+void TmScheduler::remove ( int s )
+{ TMSESSION * p ;
+  int i, j ;
+  if ( (s < 0) || (s >= nSessions) || (session[s] == NULL) ) return ;
+  p = session[s] ;
+  if ( p->state == tmREADY )   /* out of the run queue, keeping its order */
+  { for (i = j = 0 ; i < nReady ; i++)
+      if ( runQueue[(head + i) % maxSessions] != s )
+        runQueue[(head + j++) % maxSessions] = runQueue[(head + i) % maxSessions] ;
+    nReady = j ;
+  }
+  p->m->onInput(NULL, NULL) ;
+  free(p->in) ;
+  free(p) ;
+  session[s] = NULL ;
+} /* remove */
@@ -0,0 +1,271 @@
+/****************************************************/
+/* File: tmserve.c                                  */
+/* TM execution server: jobs of a program and its   */
+/* input come on a Unix socket, and the programs    */
+/* are kept decoded in an LRU cache keyed by a hash */
+/* of their text, so that one sent again, or named  */
+/* by its hash alone, is not read again             */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "libtm.h"
+#if defined(__unix__)
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#endif
+
+/* a decoded program of the cache */
+typedef struct {
+      unsigned long long hash ;
+      TmMachine * m ;
+      long used ;          /* when last run: the LRU order */
+   } TMCACHED ;
+
+/********************************************/
+unsigned long long hashText ( const char * text, size_t len )
+{ unsigned long long h = 14695981039346656037ULL ;   /* FNV-1a */
+  size_t i ;
+  for (i = 0 ; i < len ; i++)
+  { h ^= (unsigned char) text[i] ;
+    h *= 1099511628211ULL ;
+  }
+  return h ;
+} /* hashText */
+
+#if defined(__unix__)
+
+/* Function growText returns p with room for len
+ * bytes and a '\0', *cap being the room it has
+ */
+static char * growText ( char * p, size_t * cap, size_t len )
+{ if ( len + 1 <= *cap ) return p ;
+  p = (char *) realloc(p, len + 1) ;
+  if ( p == NULL )
+  { printf("out of memory\n") ;
+    exit(1) ;
+  }
+  *cap = len + 1 ;
+  return p ;
+} /* growText */
+
+/* Functions readAll and writeAll move all len bytes
+ * at p, FALSE if the socket fails or closes first
+ */
+int readAll ( int fd, void * p, size_t len )
+{ ssize_t got ;
+  while ( len > 0 )
+  { got = read(fd, p, len) ;
+    if ( (got < 0) && (errno == EINTR) ) continue ;
+    if ( got <= 0 ) return FALSE ;
+    p = (char *) p + got ;
+    len -= got ;
+  }
+  return TRUE ;
+} /* readAll */
+
+int writeAll ( int fd, const void * p, size_t len )
+{ ssize_t put ;
+  while ( len > 0 )
+  { put = write(fd, p, len) ;
+    if ( (put < 0) && (errno == EINTR) ) continue ;
+    if ( put <= 0 ) return FALSE ;
+    p = (const char *) p + put ;
+    len -= put ;
+  }
+  return TRUE ;
+} /* writeAll */
+
+/* Function socketAddress fills a with the socket
+ * path, FALSE if it is too long
+ */
+int socketAddress ( struct sockaddr_un * a, const char * path )
+{ memset(a, 0, sizeof(*a)) ;
+  a->sun_family = AF_UNIX ;
+  if ( strlen(path) >= sizeof(a->sun_path) )
+  { printf("socket path too long: %s\n", path) ;
+    return FALSE ;
+  }
+  strcpy(a->sun_path, path) ;
+  return TRUE ;
+} /* socketAddress */
+
+/********************************************/
+/* Function findProgram returns the cached  */
+/* machine of the request, loading text if  */
+/* it is not cached and evicting the least  */
+/* recently used when the cache is full;    */
+/* NULL if it is neither cached nor sent,   */
+/* or does not load                         */
+/********************************************/
+TmMachine * findProgram ( TMCACHED * cache, int * n, int size, long now,
+                          TMREQUEST * q, char * text, int dsize, int isize )
+{ TmMachine * m ;
+  int i, lru = 0 ;
+  if ( q->programLen > 0 ) q->hash = hashText(text, q->programLen) ;
+  for (i = 0 ; i < *n ; i++)
+  { if ( cache[i].hash == q->hash )
+    { cache[i].used = now ;
+      return cache[i].m ;
+    }
+    if ( cache[i].used < cache[lru].used ) lru = i ;
+  }
+  if ( q->programLen == 0 ) return NULL ;
+  m = new TmMachine(dsize, isize) ;
+  if ( ! m->loadText(text, q->programLen) )
+  { delete m ;
+    return NULL ;
+  }
+  if ( *n < size ) lru = (*n)++ ;
+  else delete cache[lru].m ;
+  cache[lru].hash = q->hash ;
+  cache[lru].m = m ;
+  cache[lru].used = now ;
+  return m ;
+} /* findProgram */
+
+/********************************************/
+int serveTM ( const char * path, int cacheSize, long budget,
+              int dsize, int isize )
+{ struct sockaddr_un a ;
+  TMCACHED * cache ;
+  TMREQUEST q ;
+  TMREPLY r ;
+  TMOUTBUF o ;
+  TmMachine * m ;
+  struct timeval timeout ;
+  char * text = NULL, * input = NULL ;
+  size_t textCap = 0, inputCap = 0 ;
+  int s, c, n = 0 ;
+  long now = 0, limit ;
+  if ( cacheSize < 1 ) cacheSize = 1 ;
+  if ( ! socketAddress(&a, path) ) return 1 ;
+  s = socket(AF_UNIX, SOCK_STREAM, 0) ;
+  unlink(path) ;
+  if ( (s < 0) || (bind(s, (struct sockaddr *) &a, sizeof(a)) < 0) || (listen(s, 16) < 0) )
+  { printf("cannot listen on %s: %s\n", path, strerror(errno)) ;
+    return 1 ;
+  }
+  signal(SIGPIPE, SIG_IGN) ;
+  cache = (TMCACHED *) growArray(NULL, 0, cacheSize, sizeof(TMCACHED)) ;
+  memset(&o, 0, sizeof(o)) ;
+  for (;;)
+  { c = accept(s, NULL, NULL) ;
+    if ( c < 0 )
+    { if ( errno == EINTR ) continue ;
+      break ;
+    }
+    /* a client that stalls is dropped, not waited for */
+    timeout.tv_sec = TMSERVETIMEOUT ;
+    timeout.tv_usec = 0 ;
+    setsockopt(c, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) ;
+    /* the jobs of a connection, until it closes */
+    while ( readAll(c, &q, sizeof(q)) )
+    { if ( (q.programLen > TMMAXREQUEST) || (q.inputLen > TMMAXREQUEST) )
+      { memset(&r, 0, sizeof(r)) ;
+        r.hash = q.hash ;
+        r.result = TMUNKNOWN ;
+        writeAll(c, &r, sizeof(r)) ;
+        break ;
+      }
+      text = growText(text, &textCap, q.programLen) ;
+      input = growText(input, &inputCap, q.inputLen) ;
+      if ( ! readAll(c, text, q.programLen) || ! readAll(c, input, q.inputLen) ) break ;
+      m = findProgram(cache, &n, cacheSize, ++now, &q, text, dsize, isize) ;
+      memset(&r, 0, sizeof(r)) ;
+      r.hash = q.hash ;
+      o.len = 0 ;
+      if ( m == NULL ) r.result = TMUNKNOWN ;
+      else
+      { limit = q.budget ;
+        if ( (budget > 0) && ((limit <= 0) || (limit > budget)) ) limit = budget ;
+        if ( limit <= 0 ) limit = TMSERVEBUDGET ;
+        m->reset () ;
+        m->onOutput(bufferOut, &o) ;
+        openText(input, q.inputLen) ;
+        r.result = m->run(limit) ;
+        r.count = m->executed () ;
+        r.outLen = (unsigned int) o.len ;
+      }
+      if ( ! writeAll(c, &r, sizeof(r)) || ! writeAll(c, o.text, o.len) ) break ;
+    }
+    close(c) ;
+  }
+  printf("cannot accept on %s: %s\n", path, strerror(errno)) ;
+  return 1 ;
+} /* serveTM */
+
+/********************************************/
+int submitTM ( const char * path, const char * name, const char * inputName,
+               long budget )
+{ struct sockaddr_un a ;
+  TMREQUEST q ;
+  TMREPLY r ;
+  char * text, * input, * out = NULL ;
+  size_t len, inputLen, outCap = 0 ;
+  int s, sent = FALSE ;
+  if ( ! socketAddress(&a, path) ) return 1 ;
+  text = readText(name, &len) ;
+  if ( text == NULL )
+  { printf("file '%s' not found\n", name) ;
+    return 1 ;
+  }
+  printf("%s < %s: ", name, inputName) ;
+  input = readText(inputName, &inputLen) ;
+  if ( input == NULL )
+  { printf("input not found\n") ;
+    return 1 ;
+  }
+  s = socket(AF_UNIX, SOCK_STREAM, 0) ;
+  if ( (s < 0) || (connect(s, (struct sockaddr *) &a, sizeof(a)) < 0) )
+  { printf("cannot connect to %s: %s\n", path, strerror(errno)) ;
+    return 1 ;
+  }
+  /* by hash first, and with the text if the server does not have it */
+  memset(&q, 0, sizeof(q)) ;
+  q.hash = hashText(text, len) ;
+  q.inputLen = (unsigned int) inputLen ;
+  q.budget = budget ;
+  for (;;)
+  { if ( ! writeAll(s, &q, sizeof(q)) || ! writeAll(s, text, q.programLen)
+         || ! writeAll(s, input, inputLen) || ! readAll(s, &r, sizeof(r)) )
+    { printf("lost connection to %s\n", path) ;
+      return 1 ;
+    }
+    if ( (r.result != TMUNKNOWN) || sent ) break ;
+    q.programLen = (unsigned int) len ;
+    sent = TRUE ;
+  }
+  out = growText(out, &outCap, r.outLen) ;
+  if ( ! readAll(s, out, r.outLen) ) r.outLen = 0 ;
+  close(s) ;
+  if ( r.result == TMUNKNOWN ) printf("program not loaded\n") ;
+  else printf("%s, %lld instructions\n",
+              (r.result == srOKAY) ? "Budget spent" : stepResultTab[r.result], r.count) ;
+  fwrite(out, 1, r.outLen, stdout) ;
+  free(out) ;
+  free(input) ;
+  free(text) ;
+  return (r.result == srHALT) ? 0 : 1 ;
+} /* submitTM */
+
+#else
+
+int serveTM ( const char * path, int cacheSize, long budget,
+              int dsize, int isize )
+{ printf("--serve needs Unix sockets\n") ;
+  return 1 ;
+} /* serveTM */
+
+int submitTM ( const char * path, const char * name, const char * inputName,
+               long budget )
+{ printf("--submit needs Unix sockets\n") ;
+  return 1 ;
+} /* submitTM */
+
+#endif
@@ -0,0 +1,390 @@
+/****************************************************/
+/* File: tmtest.c                                   */
+/* Checks of libtm: each check runs small programs  */
+/* on TmMachines and reports any result other than  */
+/* the one expected; the exit status is the number  */
+/* of checks that failed                            */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libtm.h"
+
+/* loads reg 0 from 3(5), OUTs it, and stores at
+ * 900(5): with reg 5 at its initial 0 the verifier
+ * proves both addresses
+ */
+static const char * viaReg5 =
+  "0: LD 0,3(5)\n"
+  "1: OUT 0,0,0\n"
+  "2: ST 1,900(5)\n"
+  "3: HALT 0,0,0\n" ;
+
+/* counts reg 1 down from IN, OUTing each value */
+static const char * countDown =
+  "0: IN 1,0,0\n"
+  "1: LDA 1,-1(1)\n"
+  "2: OUT 1,0,0\n"
+  "3: JGT 1,-3(7)\n"
+  "4: HALT 0,0,0\n" ;
+
+/* halves IN until it is 0, OUTing each value: in
+ * floats if IN is one
+ */
+static const char * halves =
+  "0: IN 1,0,0\n"
+  "1: LDC 2,2(0)\n"
+  "2: DIV 1,1,2\n"
+  "3: OUT 1,0,0\n"
+  "4: JGT 1,-3(7)\n"
+  "5: HALT 0,0,0\n" ;
+
+/* faults of each kind, by input: LD past dMem or
+ * below it, a jump out of iMem, DIV by 0
+ */
+static const char * faults =
+  "0: IN 1,0,0\n"
+  "1: IN 2,0,0\n"
+  "2: IN 3,0,0\n"
+  "3: LD 4,0(1)\n"
+  "4: LDC 5,7(0)\n"
+  "5: DIV 6,5,3\n"
+  "6: OUT 6,0,0\n"
+  "7: JEQ 0,8(2)\n"
+  "8: HALT 0,0,0\n" ;
+
+/* enters the fused compare SUB 0,1,2; %s 0,2(7);
+ * LDC 0,0; LDA 7,1(7); LDC 0,1 at 1 + reg 3, and
+ * OUTs reg 0
+ */
+static const char * fusedCmp =
+  "0: LDA 7,1(3)\n"
+  "1: SUB 0,1,2\n"
+  "2: %s 0,2(7)\n"
+  "3: LDC 0,0(0)\n"
+  "4: LDA 7,1(7)\n"
+  "5: LDC 0,1(0)\n"
+  "6: OUT 0,0,0\n"
+  "7: HALT 0,0,0\n" ;
+
+/******** vars ********/
+static int failures = 0 ;
+static NUM lastOut ;     /* the last value OUT */
+static int outs ;        /* the number of OUTs */
+
+/* Procedure recordOut is the OUT hook of the checks */
+static void recordOut ( void * user, NUM v )
+{ lastOut = v ;
+  outs++ ;
+} /* recordOut */
+
+/* Procedure expect reports a check whose machine
+ * gave out and result when want and wantResult were
+ * expected
+ */
+static void expect ( const char * check, STEPRESULT result, int want,
+                     STEPRESULT wantResult )
+{ if ( (outs != 1) || (lastOut.type != INT) || (lastOut.attr.valint != want) )
+  { printf("%s: OUT %d (%d OUTs), expected OUT %d\n",
+           check, lastOut.attr.valint, outs, want) ;
+    failures++ ;
+  }
+  if ( result != wantResult )
+  { printf("%s: result %d, expected %d\n", check, result, wantResult) ;
+    failures++ ;
+  }
+} /* expect */
+
+/* Function runOnce runs m from the start */
+static STEPRESULT runOnce ( TmMachine * m )
+{ outs = 0 ;
+  lastOut.type = INT ;
+  lastOut.attr.valint = 0 ;
+  m->onOutput(recordOut, NULL) ;
+  return m->run() ;
+} /* runOnce */
+
+/* Procedure setRegOf resets m to run viaReg5 with
+ * reg 5 at 100 and mem(103) at 42
+ */
+static void setRegOf ( TmMachine * m )
+{ NUM v ;
+  m->reset() ;
+  v.type = INT ;
+  v.attr.valint = 100 ;
+  m->setReg(5, v) ;
+  v.attr.valint = 42 ;
+  m->setMem(103, v) ;
+} /* setRegOf */
+
+/********************************************/
+/* The checks                               */
+/********************************************/
+
+/* a register set before the run is the one LD and
+ * ST address through, and ST past dMem faults
+ */
+static void checkSetReg ( void )
+{ TmMachine m(1000) ;
+  if ( ! m.loadText(viaReg5, strlen(viaReg5)) )
+  { printf("setReg: cannot load\n") ;
+    failures++ ;
+    return ;
+  }
+  setRegOf(&m) ;
+  expect("setReg", runOnce(&m), 42, srDMEM_ERR) ;
+  m.reset() ;
+  expect("setReg after reset", runOnce(&m), 0, srHALT) ;
+} /* checkSetReg */
+
+/* setReg on a machine sharing a program leaves the
+ * image as it was, and setReg on the image leaves
+ * the machines sharing it as they were
+ */
+static void checkSharedSetReg ( void )
+{ TmMachine image(1000) ;
+  if ( ! image.loadText(viaReg5, strlen(viaReg5)) )
+  { printf("shared setReg: cannot load\n") ;
+    failures++ ;
+    return ;
+  }
+  TmMachine before(&image) ;
+  setRegOf(&before) ;
+  expect("setReg of sharer", runOnce(&before), 42, srDMEM_ERR) ;
+  expect("image of sharer", runOnce(&image), 0, srHALT) ;
+
+  TmMachine after(&image) ;
+  setRegOf(&image) ;
+  expect("setReg of image", runOnce(&image), 42, srDMEM_ERR) ;
+  expect("sharer of image", runOnce(&after), 0, srHALT) ;
+  TmMachine late(&image) ;
+  setRegOf(&late) ;
+  expect("late sharer", runOnce(&late), 42, srDMEM_ERR) ;
+} /* checkSharedSetReg */
+
+/* Procedure compareLanes runs program on the n
+ * inputs in lanes and then one at a time, with
+ * budget, and reports each lane whose result,
+ * count or output differ
+ */
+static void compareLanes ( const char * check, const char * program,
+                           const char * inputs[], int n, long budget )
+{ TmMachine m ;
+  TMOUTBUF o [MAXLANES], one ;
+  char * text [MAXLANES] ;
+  size_t len [MAXLANES] ;
+  void * user [MAXLANES] ;
+  STEPRESULT result [MAXLANES], r ;
+  long count [MAXLANES] ;
+  int l ;
+  if ( ! m.loadText(program, strlen(program)) )
+  { printf("%s: cannot load\n", check) ;
+    failures++ ;
+    return ;
+  }
+  memset(o, 0, sizeof(o)) ;
+  memset(&one, 0, sizeof(one)) ;
+  for (l = 0 ; l < n ; l++)
+  { text[l] = (char *) inputs[l] ;
+    len[l] = strlen(inputs[l]) ;
+    user[l] = &o[l] ;
+  }
+  m.runLanes(n, text, len, bufferOut, user, result, count, budget) ;
+  for (l = 0 ; l < n ; l++)
+  { m.reset() ;
+    one.len = 0 ;
+    m.onOutput(bufferOut, &one) ;
+    openText(text[l], len[l]) ;
+    r = m.run(budget) ;
+    if ( (r != result[l]) || (m.executed() != count[l]) || (one.len != o[l].len)
+         || ((one.len > 0) && (memcmp(one.text, o[l].text, one.len) != 0)) )
+    { printf("%s, budget %ld, input '%s': %s after %ld in lanes, %s after %ld alone\n",
+             check, budget, inputs[l], stepResultTab[result[l]], count[l],
+             stepResultTab[r], m.executed()) ;
+      failures++ ;
+    }
+    free(o[l].text) ;
+  }
+  free(one.text) ;
+} /* compareLanes */
+
+/* lanes, with and without a budget, stop where a
+ * machine running alone does, with the same output,
+ * int or float
+ */
+static void checkLanes ( void )
+{ static const char * ints[] = { "3", "100000", "5", "", "1" } ;
+  static const char * mixed[] = { "3", "2.5", "100000", "-1", "1e30" } ;
+  static const long budgets[] = { 0, 1, 2, 7, 50, 1000 } ;
+  int i ;
+  for (i = 0 ; i < (int) (sizeof(budgets) / sizeof(budgets[0])) ; i++)
+  { compareLanes("int lanes", countDown, ints, 5, budgets[i]) ;
+    compareLanes("float lanes", halves, mixed, 5, budgets[i]) ;
+  }
+} /* checkLanes */
+
+/* the engines compared */
+typedef enum { engRUN, engSTEP, engJIT, NENGINES } ENGINE ;
+
+const char * engineName [NENGINES] = { "run", "step", "jit" } ;
+
+/* Function runEngine runs m on input as engine e
+ * does, from the start or, with regs, from regs 0 to
+ * PC_REG, storing its output in o and the
+ * instructions executed in *count
+ */
+static STEPRESULT runEngine ( TmMachine * m, ENGINE e, const char * input,
+                              const NUM * regs, TMOUTBUF * o, long * count )
+{ TMCONTEXT * before ;
+  STEPRESULT r ;
+  int i ;
+  o->len = 0 ;
+  m->reset() ;
+  if ( regs != NULL )
+    for (i = 0 ; i <= PC_REG ; i++) m->setReg(i, regs[i]) ;
+  m->onOutput(bufferOut, o) ;
+  before = m->bind() ;
+  openText((char *) input, strlen(input)) ;
+  *count = 0 ;
+  switch ( e )
+  { case engSTEP :
+      do
+      { r = stepTM () ;
+        if ( r != srNO_INPUT ) (*count)++ ;
+      }
+      while ( r == srOKAY ) ;
+      break ;
+    case engJIT : r = runJIT (count) ; break ;
+    default :     r = runTM (count) ; break ;
+  }
+  bindContext(before) ;
+  return r ;
+} /* runEngine */
+
+/* Procedure compareRuns runs m on input, from regs
+ * if any, with each engine and reports any whose
+ * result, count or output differ from runTM's
+ */
+static void compareRuns ( const char * check, TmMachine * m, const char * input,
+                          const NUM * regs )
+{ TMOUTBUF o [NENGINES] ;
+  STEPRESULT r [NENGINES] ;
+  long count [NENGINES] ;
+  int e ;
+  memset(o, 0, sizeof(o)) ;
+  for (e = 0 ; e < NENGINES ; e++)
+  { r[e] = runEngine(m, (ENGINE) e, input, regs, &o[e], &count[e]) ;
+    if ( (e > 0) && ( (r[e] != r[0]) || (count[e] != count[0]) || (o[e].len != o[0].len)
+                      || ((o[0].len > 0) && (memcmp(o[e].text, o[0].text, o[0].len) != 0)) ) )
+    { printf("%s, input '%s': %s after %ld with %s, %s after %ld with run\n",
+             check, input, stepResultTab[r[e]], count[e], engineName[e],
+             stepResultTab[r[0]], count[0]) ;
+      failures++ ;
+    }
+  }
+  for (e = 0 ; e < NENGINES ; e++) free(o[e].text) ;
+} /* compareRuns */
+
+/* Procedure compareEngines loads program, a file if
+ * it has no ':', and compares the engines on input
+ */
+static void compareEngines ( const char * check, const char * program,
+                             const char * input )
+{ TmMachine m ;
+  int loaded ;
+  FILE * f ;
+  if ( strchr(program, ':') == NULL )   /* a file */
+  { f = fopen(program, "r") ;
+    loaded = (f != NULL) && m.loadFile(program) ;
+    if ( f != NULL ) fclose(f) ;
+  }
+  else loaded = m.loadText(program, strlen(program)) ;
+  if ( ! loaded )
+  { printf("%s: cannot load\n", check) ;
+    failures++ ;
+    return ;
+  }
+  compareRuns(check, &m, input, NULL) ;
+} /* compareEngines */
+
+/* the JIT and single steps end as the interpreter
+ * does, with the same count and output, on the
+ * sample programs, on int and float code, and on
+ * every fault
+ */
+static void checkEngines ( void )
+{ static const char * faultInputs[] =
+    { "5 0 1", "5000 0 1", "-1 0 1", "1023 0 1", "5 0 0", "5 0 0.0",
+      "5 0 2.5", "5 100000 1", "5 -9 1", "5 1.5 1", "5 0" } ;
+  static const char * mixed[] = { "3", "2.5", "100000", "-1", "1e30" } ;
+  int i ;
+  compareEngines("sample.tm", "sample.tm", "5\n") ;
+  compareEngines("sample.tm", "sample.tm", "12\n") ;
+  compareEngines("calc.tm", "calc.tm", "") ;
+  compareEngines("triangle.tm", "triangle.tm", "") ;
+  for (i = 0 ; i < (int) (sizeof(faultInputs) / sizeof(faultInputs[0])) ; i++)
+    compareEngines("faults", faults, faultInputs[i]) ;
+  for (i = 0 ; i < (int) (sizeof(mixed) / sizeof(mixed[0])) ; i++)
+  { if ( i < 4 ) compareEngines("countDown", countDown, mixed[i]) ;   /* not 1e30: 1e30-1 is 1e30 */
+    compareEngines("halves", halves, mixed[i]) ;
+  }
+} /* checkEngines */
+
+/* the fused compare gives what its five
+ * instructions give, on int, float and -0.0
+ * operands, and when entered past its SUB by a jump
+ * or by setReg of PC_REG
+ */
+static void checkFusedCmp ( void )
+{ static const char * jumps[] = { "JLT", "JLE", "JGT", "JGE", "JEQ", "JNE" } ;
+  static const struct { int isFloat ; int i ; float f ; } vals[] =
+    { {0, 3, 0}, {0, 5, 0}, {0, 0, 0}, {0, -1, 0},
+      {1, 0, 2.5f}, {1, 0, -2.5f}, {1, 0, 3.0f}, {1, 0, 0.0f}, {1, 0, -0.0f} } ;
+  const int nVals = (int) (sizeof(vals) / sizeof(vals[0])) ;
+  char program [256], check [64] ;
+  NUM regs [PC_REG + 1] ;
+  int j, a, b, at, i ;
+  for (j = 0 ; j < (int) (sizeof(jumps) / sizeof(jumps[0])) ; j++)
+  { TmMachine m ;
+    sprintf(program, fusedCmp, jumps[j]) ;
+    if ( ! m.loadText(program, strlen(program)) )
+    { printf("fused %s: cannot load\n", jumps[j]) ;
+      failures++ ;
+      continue ;
+    }
+    for (a = 0 ; a < nVals ; a++)
+      for (b = 0 ; b < nVals ; b++)
+        for (at = 0 ; at < 9 ; at++)   /* jump to 1..5, or set the pc to 2..5 */
+        { for (i = 0 ; i <= PC_REG ; i++)
+          { regs[i].type = INT ;
+            regs[i].attr.valint = 0 ;
+          }
+          for (i = 0 ; i < 3 ; i++)   /* reg 0 as reg 1, for entry at the jump */
+          { const int v = (i == 2) ? b : a ;
+            regs[i].type = vals[v].isFloat ? FLOAT : INT ;
+            if ( vals[v].isFloat ) regs[i].attr.valfloat = vals[v].f ;
+            else regs[i].attr.valint = vals[v].i ;
+          }
+          if ( at < 5 ) regs[3].attr.valint = at ;
+          else regs[PC_REG].attr.valint = at - 3 ;
+          sprintf(check, "fused %s, operands %d and %d, %s %d", jumps[j], a, b,
+                  (at < 5) ? "jump to" : "pc at", (at < 5) ? at + 1 : at - 3) ;
+          compareRuns(check, &m, "", regs) ;
+        }
+  }
+} /* checkFusedCmp */
+
+/********************************************/
+/* the main program                         */
+/********************************************/
+int main ( int argc, char * argv[] )
+{ guardMemory = TRUE ;   /* for the JIT, as tm --jit */
+  checkSetReg() ;
+  checkSharedSetReg() ;
+  checkLanes() ;
+  checkEngines() ;
+  checkFusedCmp() ;
+  if ( failures == 0 ) printf("all checks passed\n") ;
+  return failures ;
+} /* main */
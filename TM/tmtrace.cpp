@@ -0,0 +1,116 @@
+/****************************************************/
+/* File: tmtrace.c                                  */
+/* Decoder of the binary traces written by          */
+/* tm --trace: prints the recorded instructions,    */
+/* optionally only those in a pc range or the last  */
+/* n of them, with the program's listing            */
+/****************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tm.h"
+
+/******** vars ********/
+TRACEHEADER head ;
+TRACERECORD * ring ;
+int listing = FALSE ;   /* TRUE: iMem holds the traced program */
+
+/********************************************/
+/* Procedure writeRecord prints instruction */
+/* seq of the run, the value it left in its */
+/* first register and the dMem address it   */
+/* used                                     */
+/********************************************/
+void writeRecord ( long seq, TRACERECORD * rec )
+{ int len ;
+  printf("%10ld %5d: ", seq, rec->pc) ;
+  if ( listing && (rec->pc < iaddrSize) )
+    len = printInstruction(stdout, rec->pc) ;
+  else
+    len = printf("%6s%3d", (rec->op < opRALim) ? opCodeTab[rec->op] : "????",
+                 rec->reg) ;
+  printf("%*s  r%d = ", (len < 18) ? 18 - len : 0, "", rec->reg) ;
+  if ( rec->isFloat ) printf("%.4f", rec->value.valfloat) ;
+  else printf("%d", rec->value.valint) ;
+  if ( rec->addr >= 0 ) printf("  mem[%d]", rec->addr) ;
+  printf("\n") ;
+} /* writeRecord */
+
+/********************************************/
+/* E X E C U T I O N   B E G I N S   H E R E */
+/********************************************/
+
+int main( int argc, char * argv[] )
+{ long lo = 0, hi = IADDR_MAX, last = -1 ;
+  long first, seq, matches ;
+  int argi ;
+  FILE * f ;
+  for (argi = 1 ; (argi < argc) && (argv[argi][0] == '-') ; argi++)
+  { if ( (strcmp(argv[argi], "-r") == 0) && (argi + 2 < argc) )
+    { lo = atol(argv[++argi]) ;
+      hi = atol(argv[++argi]) ;
+    }
+    else if ( (strcmp(argv[argi], "-l") == 0) && (argi + 1 < argc) )
+      last = atol(argv[++argi]) ;
+    else break ;
+  }
+  if ( (argi != argc - 1) && (argi != argc - 2) )
+  { printf("usage: %s [-r lo hi] [-l n] <trace> [<program>]\n", argv[0]) ;
+    exit(1) ;
+  }
+
+  f = fopen(argv[argi], "rb") ;
+  if ( f == NULL )
+  { printf("file '%s' not found\n", argv[argi]) ;
+    exit(1) ;
+  }
+  if ( (fread(&head, sizeof(head), 1, f) != 1)
+       || (memcmp(head.magic, TRACE_MAGIC, sizeof(head.magic)) != 0)
+       || (head.records < 1) || ((head.records & (head.records - 1)) != 0) )
+  { printf("'%s' is not a TM trace\n", argv[argi]) ;
+    exit(1) ;
+  }
+  ring = (TRACERECORD *) malloc((size_t) head.records * sizeof(TRACERECORD)) ;
+  if ( ring == NULL )
+  { printf("out of memory\n") ;
+    exit(1) ;
+  }
+  if ( fread(ring, sizeof(TRACERECORD), head.records, f) != (size_t) head.records )
+  { printf("'%s' is truncated\n", argv[argi]) ;
+    exit(1) ;
+  }
+  fclose(f) ;
+
+  /* the program, for the listing of each instruction */
+  if ( argi == argc - 2 )
+  { pgm = fopen(argv[argi+1], "r") ;
+    if ( pgm == NULL )
+    { printf("file '%s' not found\n", argv[argi+1]) ;
+      exit(1) ;
+    }
+    if ( ! readInstructions ()) exit(1) ;
+    listing = TRUE ;
+  }
+
+  first = (head.count > head.records) ? head.count - head.records : 0 ;
+  printf("%ld instructions, last %ld kept: %s\n", head.count,
+         head.count - first,
+         ((head.result >= srOKAY) && (head.result <= srNO_INPUT))
+           ? stepResultTab[head.result] : "?") ;
+
+  /* with -l n, skip all but the last n in the range */
+  matches = 0 ;
+  if ( last >= 0 )
+    for (seq = first ; seq < head.count ; seq++)
+    { TRACERECORD * rec = &ring[seq & (head.records - 1)] ;
+      if ( (rec->pc >= lo) && (rec->pc <= hi) ) matches++ ;
+    }
+  for (seq = first ; seq < head.count ; seq++)
+  { TRACERECORD * rec = &ring[seq & (head.records - 1)] ;
+    if ( (rec->pc < lo) || (rec->pc > hi) ) continue ;
+    if ( (last >= 0) && (matches-- > last) ) continue ;
+    writeRecord(seq, rec) ;
+  }
+  return 0 ;
+} /* main */